@@ -0,0 +1,471 @@
+/**
+ * bench.cpp
+ *
+ * In this file, we implement the benchmark driver of the project.
+ * The driver measures the host's peak floating point throughput and
+ * memory bandwidth, and then times every kernel of the training step
+ * in isolation across a sweep of layer widths, batch sizes and thread
+ * counts. Every result is reported in ns/sample, GFLOP/s and GB/s, and
+ * as a percentage of the roofline bound of the host. The results are
+ * also exported as JSON, so that regressions can be tracked between
+ * versions of the project.
+ */
+
+#include "driver.hpp"
+
+#include <zlib.h>                                      /// gzopen(), gzwrite()
+
+#ifndef NN_VERSION
+#define NN_VERSION "unknown"
+#endif
+
+constexpr double BENCH_MIN_TIME = 0.05;                 /// Declares the minimum duration (in seconds) of a timed measurement
+constexpr int BENCH_INPUT = 784;                        /// Declares the input size of the benchmarked models
+constexpr int BENCH_CSV_SAMPLES = 2000;                 /// Declares the number of rows of the synthetic CSV used to benchmark ingest
+constexpr size_t BENCH_STREAM_DOUBLES = 1 << 23;        /// Declares the length of each vector used by the bandwidth benchmark
+constexpr char BENCH_CSV_FILEPATH[] = "./build/bench-ingest.csv";
+                                                        /// Declares the filepath of the synthetic CSV used to benchmark ingest
+constexpr char BENCH_IDX_FILEPATH[] = "./build/bench-images-idx3-ubyte";
+                                                        /// Declares the filepath of the synthetic IDX images (and, with `.gz`, of their compressed copy) used to benchmark ingest
+constexpr char BENCH_RESULTS_FILEPATH[] = "./build/bench.json";
+                                                        /// Declares the filepath of the machine-readable results
+
+/**
+ * Holds the result of a benchmarked kernel.
+ */
+struct bench_result
+{
+    std::string phase;
+    int width, batch, threads;
+    double ns_per_sample, gflops, gbs, roofline;
+};
+
+/**
+ * Holds the measured peaks of the host.
+ */
+struct machine_peaks
+{
+    double gflops, gbs;
+};
+
+/**
+ * Repeats a kernel until at least `BENCH_MIN_TIME` seconds have elapsed.
+ *
+ * @param[in] kernel the callable to time
+ *
+ * @return the average duration of a single call in seconds
+ */
+template <typename F>
+double time_kernel(F kernel)
+{
+    int repetitions = 0;
+    double start, end;
+
+    kernel();                                                                           /// Warms up caches and the thread team
+    start = omp_get_wtime();
+    do
+    {
+        kernel();
+        repetitions += 1;
+        end = omp_get_wtime();
+    } while (end - start < BENCH_MIN_TIME);
+
+    return (end - start) / repetitions;
+}
+
+/**
+ * Measures the host's peak double precision throughput using independent
+ * multiply-add chains that the compiler can vectorize.
+ *
+ * @param[in] threads the number of threads to use
+ *
+ * @return the measured peak in GFLOP/s
+ */
+double measure_peak_flops(int threads)
+{
+    constexpr int LANES = 64, ITERATIONS = 1 << 16;
+    double sink = 0.0;
+
+    double seconds = time_kernel([&]() {
+#pragma omp parallel num_threads(threads) reduction(+ : sink)
+        {
+            double acc[LANES], x = 1.0 + 1e-9 * omp_get_thread_num(), y = 0.999999;
+            for (int i = 0; i < LANES; i += 1)
+            {
+                acc[i] = i;
+            }
+            for (int it = 0; it < ITERATIONS; it += 1)
+            {
+#pragma omp simd
+                for (int i = 0; i < LANES; i += 1)
+                {
+                    acc[i] = acc[i] * y + x;                                            /// One multiply and one add per lane
+                }
+            }
+            for (int i = 0; i < LANES; i += 1)
+            {
+                sink += acc[i];
+            }
+        }
+    });
+
+    if (sink == 42.0)                                                                   /// Keeps the compiler from removing the kernel
+    {
+        std::cout << "";
+    }
+    return 2.0 * LANES * ITERATIONS * threads / seconds * 1e-9;
+}
+
+/**
+ * Measures the host's peak memory bandwidth using the STREAM triad kernel.
+ *
+ * @param[in] threads the number of threads to use
+ *
+ * @return the measured peak in GB/s
+ */
+double measure_peak_bandwidth(int threads)
+{
+    std::vector<double> x(BENCH_STREAM_DOUBLES, 1.0), y(BENCH_STREAM_DOUBLES, 2.0), z(BENCH_STREAM_DOUBLES, 0.0);
+    double* px = x.data(), * py = y.data(), * pz = z.data();
+
+    double seconds = time_kernel([&]() {
+#pragma omp parallel for simd num_threads(threads) schedule(static)
+        for (size_t i = 0; i < BENCH_STREAM_DOUBLES; i += 1)
+        {
+            pz[i] = px[i] + 3.0 * py[i];
+        }
+    });
+
+    return 3.0 * sizeof(double) * BENCH_STREAM_DOUBLES / seconds * 1e-9;
+}
+
+/**
+ * Fills a dataset with random samples, as if it had been parsed from a CSV file.
+ *
+ * @param[in, out] data the dataset to fill
+ * @param[in] dimensions the size of the input of every sample
+ */
+void synthesize(dataset(&data), int dimensions)
+{
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<> dist(0.0, 1.0);
+
+    data.dimensions = dimensions;
+    data.X = new double* [data.samples];
+    data.Y = new double* [data.samples];
+    for (int i = 0; i < data.samples; i += 1)
+    {
+        data.X[i] = new double[dimensions];
+        data.Y[i] = new double[data.classes];
+        for (int j = 0; j < dimensions; j += 1)
+        {
+            data.X[i][j] = dist(gen) < 0.5 ? 0.0 : dist(gen);                          /// Mimics the sparsity of the MNIST images
+        }
+        for (int j = 0; j < data.classes; j += 1)
+        {
+            data.Y[i][j] = (j == i % data.classes) ? 1.0 : 0.0;
+        }
+    }
+}
+
+/**
+ * Writes a synthetic CSV file with the layout of the Kaggle MNIST export.
+ *
+ * @param[in] filename the file path of the CSV file
+ * @param[in] samples the number of rows to write
+ */
+void write_csv(const char* filename, int samples)
+{
+    std::ofstream stream(filename);
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<> pixel(0, 255), label(0, MNIST_CLASSES - 1);
+
+    stream << "label";
+    for (int j = 0; j < BENCH_INPUT; j += 1)
+    {
+        stream << ",pixel" << j + 1;
+    }
+    stream << "\n";
+    for (int i = 0; i < samples; i += 1)
+    {
+        stream << label(gen);
+        for (int j = 0; j < BENCH_INPUT; j += 1)
+        {
+            int value = pixel(gen);
+            stream << "," << (value < 128 ? 0 : value);
+        }
+        stream << "\n";
+    }
+}
+
+/**
+ * Writes a synthetic pair of IDX files (images and labels) with the same samples as `write_csv()`.
+ *
+ * @param[in] filename the file path of the images, ending with `.gz` to compress both files
+ * @param[in] samples the number of samples to write
+ */
+void write_idx(std::string filename, int samples)
+{
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<> pixel(0, 255), label(0, MNIST_CLASSES - 1);
+    std::vector<unsigned char> images = { 0, 0, 8, 3 }, labels = { 0, 0, 8, 1 };
+
+    for (uint32_t word : { (uint32_t)samples, (uint32_t)MNIST_HEIGHT, (uint32_t)MNIST_WIDTH })          /// Big-endian dimensions
+    {
+        for (int shift = 24; shift >= 0; shift -= 8)
+        {
+            images.push_back((word >> shift) & 0xFF);
+            if (labels.size() < 8)
+            {
+                labels.push_back((word >> shift) & 0xFF);
+            }
+        }
+    }
+    for (int i = 0; i < samples; i += 1)
+    {
+        labels.push_back(label(gen));
+        for (int j = 0; j < BENCH_INPUT; j += 1)
+        {
+            int value = pixel(gen);
+            images.push_back(value < 128 ? 0 : value);
+        }
+    }
+
+    auto put = [](const std::string& path, const std::vector<unsigned char>& bytes) {
+        if (path.size() > 3 && path.compare(path.size() - 3, 3, ".gz") == 0)
+        {
+            gzFile stream = gzopen(path.c_str(), "wb");
+            gzwrite(stream, bytes.data(), bytes.size());
+            gzclose(stream);
+            return;
+        }
+        std::ofstream(path, std::ios::binary).write((const char*)bytes.data(), bytes.size());
+    };
+    put(filename, images);
+    put(idx_labels_filepath(filename), labels);
+}
+
+/**
+ * Completes a result with throughput figures and its roofline bound.
+ *
+ * @param[in, out] result the result to complete
+ * @param[in] seconds the duration of a batch
+ * @param[in] flops the floating point operations of a single sample
+ * @param[in] bytes the bytes moved from and to memory by a single sample
+ * @param[in] peaks the measured peaks of the host
+ *
+ * @note    The roofline bound of a kernel is the time it would take at the host's peak compute
+ *          throughput or peak memory bandwidth, whichever is the slowest. The reported percentage
+ *          is the bound over the measured time, so kernels whose working set fits in the caches
+ *          may exceed 100 %, since the bandwidth peak is measured against main memory.
+ */
+void complete(bench_result(&result), double seconds, double flops, double bytes, machine_peaks(&peaks))
+{
+    double per_sample = seconds / result.batch;
+    double bound = std::max(flops / (peaks.gflops * 1e9), bytes / (peaks.gbs * 1e9));   /// Roofline: max(compute time, memory time)
+
+    result.ns_per_sample = per_sample * 1e9;
+    result.gflops = flops / per_sample * 1e-9;
+    result.gbs = bytes / per_sample * 1e-9;
+    result.roofline = 100.0 * bound / per_sample;
+}
+
+/**
+ * Benchmarks every kernel of a training step for a model with a single hidden layer.
+ *
+ * @param[in] width the size of the hidden layer
+ * @param[in] batch the number of consecutive samples processed per timed call
+ * @param[in] threads the number of threads to use
+ * @param[in, out] data the dataset to draw samples from
+ * @param[in] peaks the measured peaks of the host
+ * @param[in, out] results the container to be given the results
+ */
+void bench_model(int width, int batch, int threads, dataset(&data), machine_peaks(&peaks), std::vector<bench_result>& results)
+{
+    nn model;
+    std::vector<int> l = { BENCH_INPUT + 1, width + 1, MNIST_CLASSES };
+
+    host.threads = threads;
+    model.tune = false;                                                                 /// Keeps every kernel on the thread count under measurement
+    model.compile(l, -1.0, 1.0);                                                        /// Compiles after `host.threads` is set, so that the first touch matches the sweep
+
+    double W = 0.0, W_hidden = 0.0, N = 0.0;                                            /// Number of weights, weights after the first layer and neurons
+    for (int i = 1; i < l.size(); i += 1)
+    {
+        int rows = (i == l.size() - 1) ? l[i] : l[i] - 1;
+        W += (double)rows * l[i - 1];
+        W_hidden += (i > 1) ? (double)rows * l[i - 1] : 0.0;
+        N += l[i];
+    }
+    N += l[0];
+
+    auto run = [&](const char* phase, double flops, double bytes, auto kernel) {
+        bench_result result = { phase, width, batch, threads, 0.0, 0.0, 0.0, 0.0 };
+        double seconds = time_kernel([&]() {
+            for (int sample = 0; sample < batch; sample += 1)
+            {
+                kernel(sample % data.samples);
+            }
+        });
+        complete(result, seconds, flops, bytes, peaks);
+        results.push_back(result);
+    };
+
+    model.bind_input(data.X[0]);
+    model.forward();
+
+    run("forward", 2.0 * W + 4.0 * (N - l[0]), sizeof(double) * (W + N), [&](int s) { model.bind_input(data.X[s]); model.forward(); });
+    run("back_propagation", 2.0 * W_hidden + 3.0 * (N - l[0]), sizeof(double) * (W_hidden + 3.0 * N), [&](int s) { model.back_propagation(data.Y[s]); });
+    run("optimize", 3.0 * W, sizeof(double) * (2.0 * W + 2.0 * N), [&](int /*s*/) { model.optimize(); });
+    run("sigmoid", 4.0 * width, sizeof(double) * 2.0 * width, [&](int /*s*/) {
+        double* a = model.a[1];
+#pragma omp parallel for num_threads(host.threads) schedule(static)
+        for (int neuron = 0; neuron < width; neuron += 1)
+        {
+            a[neuron] = sigmoid(a[neuron]);                                             /// Filters the hidden layer in place
+        }
+    });
+    run("train_step", 2.0 * W + 2.0 * W_hidden + 3.0 * W, sizeof(double) * (3.0 * W + 4.0 * N), [&](int s) {
+        model.bind_input(data.X[s]);
+        model.forward();
+        model.back_propagation_update(data.Y[s]);                                       /// Streams the weights once for the backward pass and the update
+    });
+}
+
+/**
+ * Benchmarks the ingest of a dataset file.
+ *
+ * @param[in] phase the name of the result
+ * @param[in] filename the file path of the dataset, in any format `dataset::load()` reads
+ * @param[in] threads the number of threads to use
+ * @param[in] peaks the measured peaks of the host
+ * @param[in, out] results the container to be given the results
+ */
+void bench_ingest(const char* phase, const char* filename, int threads, machine_peaks(&peaks), std::vector<bench_result>& results)
+{
+    FILE* stream = fopen(filename, "rb");
+    if (stream == NULL)
+    {
+        throw std::runtime_error(std::string("bench: cannot open ") + filename);
+    }
+    fseek(stream, 0, SEEK_END);
+    double bytes = (double)ftell(stream) / BENCH_CSV_SAMPLES;
+    fclose(stream);
+
+    host.threads = threads;
+    double start = omp_get_wtime();
+    {
+        dataset data(MNIST_CLASSES, BENCH_CSV_SAMPLES);
+        data.load(filename, 0, MNIST_MAX_VAL);
+    }
+    double seconds = omp_get_wtime() - start;
+
+    bench_result result = { phase, BENCH_INPUT, BENCH_CSV_SAMPLES, threads, 0.0, 0.0, 0.0, 0.0 };
+    complete(result, seconds, BENCH_INPUT, bytes, peaks);                              /// One conversion per pixel
+    results.push_back(result);
+}
+
+/**
+ * Exports the results as a JSON document.
+ *
+ * @param[in] filename the file path of the JSON document
+ * @param[in] peaks the measured peaks of the host
+ * @param[in] results the results of the benchmark
+ */
+void export_results(const char* filename, machine_peaks(&peaks), std::vector<bench_result>& results)
+{
+    std::ofstream stream(filename);
+
+    stream << "{\n  \"version\": \"" << NN_VERSION << "\",\n";
+    stream << "  \"threads\": " << host.threads << ",\n  \"nodes\": " << host.nodes << ",\n";
+    stream << "  \"peak_gflops\": " << peaks.gflops << ",\n  \"peak_gbs\": " << peaks.gbs << ",\n";
+    stream << "  \"results\": [\n";
+    for (int i = 0; i < results.size(); i += 1)
+    {
+        bench_result& r = results[i];
+        stream << "    {\"phase\": \"" << r.phase << "\", \"width\": " << r.width << ", \"batch\": " << r.batch
+               << ", \"threads\": " << r.threads << ", \"ns_per_sample\": " << r.ns_per_sample
+               << ", \"gflops\": " << r.gflops << ", \"gbs\": " << r.gbs << ", \"roofline\": " << r.roofline
+               << "}" << (i == results.size() - 1 ? "\n" : ",\n");
+    }
+    stream << "  ]\n}\n";
+}
+
+/**
+ * Implements the benchmark driver.
+ *
+ * @param[in] argc number of user arguments
+ * @param[in] argv vector of user arguments
+ *
+ * @return 0, if the executable was terminated normally
+ *
+ * @note    The `-t` and `-a` options have the same meaning as for the project's driver.
+ *          The sweep covers powers of two threads up to the number of threads found.
+ */
+int main(int argc, char* argv[])
+{
+    std::vector<int> vec, widths = { 32, 128, 512, 2048 }, batches = { 1, 64, 1024 }, threads;
+    std::vector<bench_result> results;
+    machine_peaks peaks;
+    nn settings;                                                                    /// Receives the model options, which the sweep ignores
+
+    parse_arguments(argc, argv, vec, settings);
+    host.detect();
+    host.bind();
+
+    for (int t = 1; t < host.threads; t *= 2)
+    {
+        threads.push_back(t);
+    }
+    threads.push_back(host.threads);
+
+    peaks.gflops = measure_peak_flops(host.threads);
+    peaks.gbs = measure_peak_bandwidth(host.threads);
+
+    write_csv(BENCH_CSV_FILEPATH, BENCH_CSV_SAMPLES);
+    write_idx(BENCH_IDX_FILEPATH, BENCH_CSV_SAMPLES);
+    write_idx(std::string(BENCH_IDX_FILEPATH) + ".gz", BENCH_CSV_SAMPLES);
+    for (auto& t : threads)
+    {
+        bench_ingest("read_csv", BENCH_CSV_FILEPATH, t, peaks, results);
+        bench_ingest("read_idx", BENCH_IDX_FILEPATH, t, peaks, results);
+        bench_ingest("read_idx_gz", (std::string(BENCH_IDX_FILEPATH) + ".gz").c_str(), t, peaks, results);
+    }
+    remove(BENCH_CSV_FILEPATH);
+    for (std::string images : { std::string(BENCH_IDX_FILEPATH), std::string(BENCH_IDX_FILEPATH) + ".gz" })
+    {
+        remove(images.c_str());                                                     /// Removes the synthetic IDX pairs
+        remove(idx_labels_filepath(images).c_str());
+    }
+
+    dataset data(MNIST_CLASSES, 1024);
+    synthesize(data, BENCH_INPUT);
+
+    for (auto& t : threads)
+    {
+        for (auto& width : widths)
+        {
+            for (auto& batch : batches)
+            {
+                bench_model(width, batch, t, data, peaks, results);
+            }
+        }
+    }
+    host.threads = threads.back();
+
+    std::cout << "\n\nBenchmark [" << NN_VERSION << "]\t[peak " << std::fixed << std::setprecision(2) << peaks.gflops << " GFLOP/s, " << peaks.gbs << " GB/s]\n";
+    std::cout << std::string(CLI_WINDOW_WIDTH + 40, '-') << "\n";
+    std::cout << std::setw(18) << "phase" << std::setw(7) << "width" << std::setw(7) << "batch" << std::setw(8) << "threads"
+              << std::setw(14) << "ns/sample" << std::setw(11) << "GFLOP/s" << std::setw(10) << "GB/s" << std::setw(12) << "% roofline\n";
+    for (auto& r : results)
+    {
+        std::cout << std::setw(18) << r.phase << std::setw(7) << r.width << std::setw(7) << r.batch << std::setw(8) << r.threads
+                  << std::setw(14) << std::setprecision(1) << r.ns_per_sample << std::setw(11) << std::setprecision(3) << r.gflops
+                  << std::setw(10) << r.gbs << std::setw(11) << std::setprecision(1) << r.roofline << "\n";
+    }
+
+    export_results(BENCH_RESULTS_FILEPATH, peaks, results);
+    std::cout << "\nResults exported to " << BENCH_RESULTS_FILEPATH << "\n";
+
+    return(0);
+}
@@ -0,0 +1,204 @@
+/**
+ * hotswap.cpp
+ *
+ * In this file, we implement the stress test of the hot-swap of the
+ * library's models (`nn_load_into()`). Two versions of the same model
+ * are checkpointed, and their outputs on a fixed batch are recorded.
+ * Several readers then run inference on the model without pause while
+ * the main thread swaps the two checkpoints in, back and forth. Every
+ * output a reader sees must be exactly the one of either version; a mix
+ * of the two (a torn read) fails the test. The test only goes through
+ * the C interface of lib/libnn.h, and is linked against `libnn.a`.
+ *
+ * Run it with `make check`. To check the reclamation of the replaced
+ * versions too, build it with AddressSanitizer (`make check SANITIZE=1`,
+ * see the makefile).
+ */
+
+#include "libnn.h"
+
+#include <atomic>                                       /// std::atomic
+#include <cstdio>                                       /// std::printf(), std::remove()
+#include <cstring>                                      /// std::memcmp()
+#include <random>                                       /// std::mt19937
+#include <thread>                                       /// std::thread
+#include <vector>                                       /// std::vector
+
+constexpr int HOTSWAP_SIZES[] = { 784, 100, 10 };       /// Declares the layers of the swapped model
+constexpr int HOTSWAP_BATCH = 16;                       /// Declares the batch size of every inference
+constexpr int HOTSWAP_READERS = 4;                      /// Declares the number of concurrent readers
+constexpr int HOTSWAP_SWAPS = 200;                      /// Declares the number of swaps
+constexpr char HOTSWAP_A_FILEPATH[] = "./build/hotswap-a.nnck";
+                                                        /// Declares the filepath of the first version
+constexpr char HOTSWAP_B_FILEPATH[] = "./build/hotswap-b.nnck";
+                                                        /// Declares the filepath of the second version
+
+/**
+ * Holds the counts of a reader.
+ */
+struct reader_counts
+{
+    long a, b, torn;                                    /// Outputs of the first version, of the second, and of neither
+    nn_status status;                                   /// The first failed status, if any
+
+    reader_counts() :
+        a{ 0 },
+        b{ 0 },
+        torn{ 0 },
+        status{ NN_OK }
+    {
+
+    }
+};
+
+/**
+ * Runs inference until the swaps are done, and classifies every output.
+ *
+ * @param[in] model the swapped model
+ * @param[in] X the batch
+ * @param[in] A the output of the first version
+ * @param[in] B the output of the second version
+ * @param[in] done whether the swaps are done
+ * @param[in] workspace whether the reader passes its own workspace
+ * @param[out] counts the counts of the reader
+ *
+ * @note    The last reader passes no workspace, so that the temporary
+ *          workspaces of the library are swapped under too.
+ */
+static void read(const nn_model* model, const std::vector<double>& X, const std::vector<double>& A, const std::vector<double>& B,
+    const std::atomic<bool>& done, bool workspace, reader_counts& counts)
+{
+    nn_workspace* ws = nullptr;
+    std::vector<double> out(A.size());
+    size_t bytes = out.size() * sizeof(double);
+
+    if (workspace && (counts.status = nn_workspace_create(model, &ws)) != NN_OK)
+    {
+        return;
+    }
+
+    while (!done.load(std::memory_order_relaxed))
+    {
+        nn_status status = nn_infer_f64(model, X.data(), HOTSWAP_BATCH, out.data(), ws);
+        if (status != NN_OK)
+        {
+            counts.status = status;
+            break;
+        }
+
+        if (std::memcmp(out.data(), A.data(), bytes) == 0)
+        {
+            counts.a += 1;
+        }
+        else if (std::memcmp(out.data(), B.data(), bytes) == 0)
+        {
+            counts.b += 1;
+        }
+        else
+        {
+            counts.torn += 1;
+        }
+    }
+
+    nn_workspace_destroy(ws);
+}
+
+/**
+ * Checkpoints two versions of a model, records their outputs, and then
+ * swaps them under the concurrent readers.
+ *
+ * @return 0 if every output matched a version and every call succeeded, 1 otherwise
+ */
+int main(void)
+{
+    int count = sizeof(HOTSWAP_SIZES) / sizeof(HOTSWAP_SIZES[0]);
+    int inputs = HOTSWAP_SIZES[0], outputs = HOTSWAP_SIZES[count - 1];
+    std::vector<double> X((size_t)HOTSWAP_BATCH * inputs), Y(outputs, 0.0);
+    std::vector<double> A((size_t)HOTSWAP_BATCH * outputs), B(A.size());
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<double> pixel(0.0, 1.0);
+    nn_model* model = nullptr;
+    int failed = 0;
+
+    for (double& x : X)
+    {
+        x = pixel(gen);
+    }
+    Y[2] = 1.0;
+
+    if (nn_create(HOTSWAP_SIZES, count, 1, &model) != NN_OK                           /// Checkpoints the two versions, one training step apart
+        || nn_save(model, HOTSWAP_A_FILEPATH) != NN_OK
+        || nn_train_f64(model, X.data(), Y.data(), 1, 0.5, nullptr) != NN_OK
+        || nn_save(model, HOTSWAP_B_FILEPATH) != NN_OK)
+    {
+        std::printf("hotswap: cannot checkpoint the model - %s\n", nn_last_error());
+        nn_destroy(model);
+        return 1;
+    }
+    nn_destroy(model);
+
+    if (nn_load(HOTSWAP_A_FILEPATH, 1, &model) != NN_OK                               /// Records the output of either version
+        || nn_infer_f64(model, X.data(), HOTSWAP_BATCH, A.data(), nullptr) != NN_OK
+        || nn_load_into(model, HOTSWAP_B_FILEPATH) != NN_OK
+        || nn_infer_f64(model, X.data(), HOTSWAP_BATCH, B.data(), nullptr) != NN_OK)
+    {
+        std::printf("hotswap: cannot record the outputs - %s\n", nn_last_error());
+        nn_destroy(model);
+        return 1;
+    }
+
+    if (std::memcmp(A.data(), B.data(), A.size() * sizeof(double)) == 0)
+    {
+        std::printf("hotswap: the two versions have the same output\n");
+        failed = 1;
+    }
+
+    std::atomic<bool> done{ false };
+    std::vector<reader_counts> counts(HOTSWAP_READERS);
+    std::vector<std::thread> readers;
+    for (int reader = 0; reader < HOTSWAP_READERS; reader += 1)
+    {
+        readers.emplace_back(read, model, std::cref(X), std::cref(A), std::cref(B), std::cref(done),
+            reader < HOTSWAP_READERS - 1, std::ref(counts[reader]));
+    }
+
+    for (int swap = 0; swap < HOTSWAP_SWAPS; swap += 1)
+    {
+        if (nn_load_into(model, swap % 2 == 0 ? HOTSWAP_A_FILEPATH : HOTSWAP_B_FILEPATH) != NN_OK)
+        {
+            std::printf("hotswap: swap %d failed - %s\n", swap, nn_last_error());
+            failed = 1;
+        }
+    }
+
+    if (nn_load_into(model, "./build/hotswap-missing.nnck") == NN_OK)                   /// A failed swap must leave the current version serving
+    {
+        std::printf("hotswap: a missing checkpoint was swapped in\n");
+        failed = 1;
+    }
+
+    done.store(true, std::memory_order_relaxed);
+    for (int reader = 0; reader < HOTSWAP_READERS; reader += 1)
+    {
+        readers[reader].join();
+        const reader_counts& c = counts[reader];
+        std::printf("hotswap: reader %d%s: [A %ld] [B %ld] [TORN %ld]\n", reader,
+            reader < HOTSWAP_READERS - 1 ? "" : " (no workspace)", c.a, c.b, c.torn);
+        if (c.status != NN_OK)
+        {
+            std::printf("hotswap: reader %d failed - status %d\n", reader, (int)c.status);
+            failed = 1;
+        }
+        if (c.torn > 0)
+        {
+            failed = 1;
+        }
+    }
+
+    nn_destroy(model);
+    std::remove(HOTSWAP_A_FILEPATH);
+    std::remove(HOTSWAP_B_FILEPATH);
+
+    std::printf("hotswap: %d swaps under %d readers - %s\n", HOTSWAP_SWAPS, HOTSWAP_READERS, failed ? "FAILED" : "passed");
+    return failed;
+}
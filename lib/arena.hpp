@@ -0,0 +1,71 @@
+/**
+ * arena.hpp
+ *
+ * In this header file, we define an
+ * arena allocator. The arena makes a
+ * single aligned allocation, backed by
+ * huge pages whenever the host allows it,
+ * and then hands out sub-buffers of that
+ * allocation. The sub-buffers are never
+ * freed one by one; the whole arena is
+ * released at once.
+ */
+
+#pragma once
+
+#include "common.hpp"
+
+#ifdef __linux__
+#include <sys/mman.h>                               /// mmap(), madvise()
+#endif
+
+constexpr size_t ARENA_ALIGNMENT = 64;              /// Defines the alignment of every sub-buffer (a cache line)
+constexpr size_t ARENA_HUGE_PAGE = 2 << 20;         /// Defines the size of a huge page
+
+/**
+ * Implements an arena allocator.
+ *
+ * The developer calls `reserve` once with the total size of
+ * the sub-buffers, and then `allocate` for every sub-buffer.
+ * If `hugetlb` is set, the arena is backed by explicitly
+ * reserved huge pages (see `/proc/sys/vm/nr_hugepages`),
+ * otherwise it asks for transparent huge pages. Both fall
+ * back to regular pages when not available.
+ */
+class arena
+{
+public:
+    char* base;
+    size_t capacity, used, mapped;
+    bool huge;
+
+    static inline size_t align(size_t bytes)
+    {
+        return (bytes + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+    }
+
+    void reserve(size_t bytes, bool hugetlb);
+    void* allocate(size_t bytes);
+    void release(void);
+
+    template <typename T>
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(allocate(n * sizeof(T)));
+    }
+
+    arena() :
+        base{ nullptr },
+        capacity{ 0 },
+        used{ 0 },
+        mapped{ 0 },
+        huge{ false }
+    {
+
+    }
+
+    ~arena()
+    {
+        release();
+    }
+};
@@ -0,0 +1,127 @@
+/**
+ * checkpoint.hpp
+ *
+ * In this header file, we define an
+ * asynchronous checkpointer. The training
+ * loop only copies the model's weights into
+ * one of two snapshot buffers; a background
+ * thread compresses the snapshot, writes it
+ * to a temporary file and atomically renames
+ * it over the previous checkpoint, so that
+ * a crash never leaves a partial checkpoint.
+ */
+
+#pragma once
+
+#include "common.hpp"
+#include "topology.hpp"
+#include "arena.hpp"
+
+#include <mutex>                                    /// std::mutex
+#include <thread>                                   /// std::thread
+#include <condition_variable>                       /// std::condition_variable
+
+constexpr uint32_t CHECKPOINT_MAGIC = 0x4B434E4E;   /// Declares the signature of a checkpoint file ("NNCK")
+constexpr uint32_t CHECKPOINT_VERSION = 1;          /// Declares the version of the checkpoint format
+constexpr char CHECKPOINT_DEFAULT_FILEPATH[] = "./build/checkpoint.nnck";
+                                                    /// Declares the filepath of the checkpoint
+
+/**
+ * Holds the header of a checkpoint file. The header is followed by
+ * the layer structure (`n_layers` integers) and the compressed weights.
+ */
+struct checkpoint_header
+{
+    uint32_t magic, version, n_layers, level;
+    uint64_t step, raw_bytes, compressed_bytes;
+};
+
+/**
+ * Implements an asynchronous checkpointer.
+ *
+ * The developer sets `every_steps` and/or `every_seconds`, calls
+ * `open` before the training, `tick` after every training step,
+ * and `close` after the training. `tick` returns right away unless
+ * a checkpoint is due, in which case the training thread copies the
+ * weights into the snapshot buffer the writer is not reading. If a
+ * snapshot is still queued, it is replaced by the newer one, so the
+ * training thread never waits for the writer.
+ */
+class checkpointer
+{
+public:
+    int every_steps;                                /// Steps between checkpoints (0 disables)
+    double every_seconds;                           /// Seconds between checkpoints (0 disables)
+    std::string filepath;
+
+    std::vector<int> layers;
+    size_t bytes;
+    arena memory;                                   /// Holds the two snapshot buffers
+    char* buffers[2];
+    int writing, pending;                           /// Buffer read by the writer and buffer queued for it (-1 if none)
+    long steps, pending_step;
+    double last;
+    bool active, stopping;
+
+    std::thread writer;
+    std::mutex lock;
+    std::condition_variable wake;
+
+    int taken, written, dropped;
+    double stall, stall_max, write_time;
+    size_t written_bytes;
+
+    void open(const std::vector<int>& l, size_t parameter_bytes);
+    void take(const void* parameters);
+    void write(int slot, long step);
+    void drain(void);
+    void close(void);
+    void report(void);
+
+    inline bool due(void)
+    {
+        steps += 1;
+        return (every_steps > 0 && steps % every_steps == 0) || (every_seconds > 0.0 && omp_get_wtime() - last >= every_seconds);
+    }
+
+    inline void tick(const void* parameters)
+    {
+        if (active && due())
+        {
+            take(parameters);
+        }
+    }
+
+    checkpointer() :
+        every_steps{ 0 },
+        every_seconds{ 0.0 },
+        filepath{ CHECKPOINT_DEFAULT_FILEPATH },
+        bytes{ 0 },
+        buffers{ nullptr, nullptr },
+        writing{ -1 },
+        pending{ -1 },
+        steps{ 0 },
+        pending_step{ 0 },
+        last{ 0.0 },
+        active{ false },
+        stopping{ false },
+        taken{ 0 },
+        written{ 0 },
+        dropped{ 0 },
+        stall{ 0.0 },
+        stall_max{ 0.0 },
+        write_time{ 0.0 },
+        written_bytes{ 0 }
+    {
+
+    }
+
+    ~checkpointer()
+    {
+        close();
+    }
+};
+
+void read_checkpoint(const char* filename, const std::vector<int>& l, void* parameters, size_t parameter_bytes, long& step);
+size_t write_checkpoint(const char* filename, const std::vector<int>& l, const void* parameters, size_t parameter_bytes, long step);
+std::vector<int> checkpoint_layers(const char* filename);
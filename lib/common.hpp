@@ -34,11 +34,21 @@
 typedef intptr_t ssize_t;                   /// Declares `ssize_t` type that is used in `Preprocessing.h`
 
 constexpr int EPOCHS = 10;                  /// Declares the number of epochs for the model's training
-constexpr int N_THREADS = 12;               /// Specifies the number of threads to request from the OS
+constexpr int N_THREADS = 0;                /// Specifies the number of threads to request from the OS (0 detects the host's logical processors at runtime)
 constexpr int N_ACTIVATIONS = 2;            /// Declares the number of neuron activation functions declared in the project
 constexpr int CLI_WINDOW_WIDTH = 50;        /// Defines the length of the progress bar for the project's CLI
 constexpr int MNIST_CLASSES = 10;           /// Declares the number of classes found in the MNIST dataset
+constexpr int MNIST_CHANNELS = 1;           /// Declares the number of channels of an image of the MNIST dataset
+constexpr int MNIST_HEIGHT = 28;            /// Declares the height of an image of the MNIST dataset
+constexpr int MNIST_WIDTH = 28;             /// Declares the width of an image of the MNIST dataset
 constexpr double LEARNING_RATE = 0.1;       /// Defines the learning rate for the neural network
+constexpr double SPARSE_DENSITY = 0.75;     /// Declares the input density under which the sparse kernels of the first layer are benchmarked against the dense ones
+constexpr int PRUNE_BLOCK = 4;              /// Declares the number of neighbouring synapses pruned and stored together (a SIMD vector of doubles)
+constexpr double PRUNE_LEVELS[] = { 0.0, 0.5, 0.75, 0.9, 0.95 };
+                                            /// Declares the sparsities reported in the pruning trade-off
+constexpr double LOWRANK_ENERGIES[] = { 1.0, 0.999, 0.99, 0.95, 0.9, 0.8 };
+                                            /// Declares the fractions of the spectral energy reported in the low-rank trade-off
+constexpr bool ARENA_HUGETLB = false;       /// Backs the model's memory by explicitly reserved huge pages instead of transparent huge pages
 constexpr double MNIST_TRAIN = 60000.0;     /// Declares the number of training examples found in the MNIST dataset
 constexpr double MNIST_TEST = 10000.0;      /// Declares the number of evaluation examples found in the MNIST dataset
 constexpr double EXP = 2.718282;            /// Defines the exponential constant `e`
@@ -0,0 +1,78 @@
+/**
+ * conv.hpp
+ *
+ * In this header file, we define the
+ * feature layers of the model: 2D
+ * convolutions and max pooling. The
+ * feature layers run in front of the
+ * fully connected layers, and their
+ * output is the input of the first fully
+ * connected layer. A convolution is
+ * lowered to a matrix product (im2col),
+ * which is computed by a cache-blocked
+ * kernel over a batch of samples at once.
+ */
+
+#pragma once
+
+#include "common.hpp"
+#include "activation.hpp"
+
+constexpr int CONV_KERNEL = 3;                      /// Declares the size of a convolution's (square) kernel
+constexpr int CONV_TILE = 64;                       /// Declares the number of output pixels computed together by the matrix product
+constexpr int CONV_BATCH = 32;                      /// Declares the number of samples fed through the feature layers at once, during inference
+
+enum layer_kind {LAYER_CONV2D, LAYER_MAXPOOL};
+
+/**
+ * Implements a feature layer (a 2D convolution or a max pooling).
+ *
+ * The values of a layer are laid out channel by channel, and
+ * within a channel sample by sample (`[channel][sample][pixel]`),
+ * so that a batch of samples forms a single matrix product. A
+ * convolution has `channels` filters of `CONV_KERNEL x CONV_KERNEL`
+ * synapses per input channel, no padding and a stride of 1, and
+ * is filtered by a ReLU. A max pooling has a `size x size` window
+ * and a stride of `size`.
+ */
+class feature_layer
+{
+public:
+    layer_kind kind;
+    int size;                                       /// Kernel size of a convolution, or window size of a pooling
+    int in_c, in_h, in_w, out_c, out_h, out_w;
+    double* weights;                                /// `out_c` rows of `in_c * size * size` synapses and a bias
+    double* out, * err;                             /// Output values (for `CONV_BATCH` samples), and their error (for a single sample)
+    double* columns, * d_columns;                   /// The lowered input, and its error
+    int* argmax;                                    /// Input position of every pooled value
+
+    inline int reduction(void) { return in_c * size * size; }
+    inline int in_pixels(void) { return in_h * in_w; }
+    inline int out_pixels(void) { return out_h * out_w; }
+    inline int outputs(void) { return out_c * out_h * out_w; }
+
+    void shape(int c, int h, int w);
+    size_t parameters(void);
+    size_t footprint(void);
+    void forward(const double* const* planes, int batch, int threads);
+    void backward(double* d_in, double learning_rate, int threads);
+
+    feature_layer(layer_kind kind, int channels, int size) :
+        kind{ kind },
+        size{ size },
+        in_c{ 0 },
+        in_h{ 0 },
+        in_w{ 0 },
+        out_c{ channels },
+        out_h{ 0 },
+        out_w{ 0 },
+        weights{ nullptr },
+        out{ nullptr },
+        err{ nullptr },
+        columns{ nullptr },
+        d_columns{ nullptr },
+        argmax{ nullptr }
+    {
+
+    }
+};
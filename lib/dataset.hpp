@@ -4,7 +4,9 @@
  * In this header file, we define a
  * class that handles a dataset. The class
  * has a function that imports the dataset
- * directly from a CSV file. There is also
+ * directly from a CSV file, and another
+ * one that imports it from the original IDX
+ * files of the dataset. There is also
  * a function that prints out the input and
  * expected output of a dataset instance.
  * Finally, while parsing the CSV file, the
@@ -15,29 +17,47 @@
 #pragma once
 
 #include "interface.hpp"
+#include "topology.hpp"
+#include "trace.hpp"
+#include "idx.hpp"
 
  /**
   * Implementation of a dataset class.
   *
   * Upon a dataset creation, the developer
-  * has to call `read_csv` providing the
-  * requested arguments to start using
-  * the created dataset instance. The dataset
+  * has to call `read_csv` (or `read_idx`, or
+  * `load` to pick either one from the file)
+  * providing the requested arguments to start
+  * using the created dataset instance. The dataset
   * has got an attribute (variable) `classes`
   * which is initialized after the number of
   * classes in a dataset. For the project's
   * purposes, this attribute has been initialized
   * with 10 (ten), since there are 10 classes in the
   * MNIST fashion dataset.
+  *
+  * Optionally, the dataset also keeps a sparse
+  * encoding of the input samples. The encoding
+  * is a Compressed Sparse Row (CSR) matrix, where
+  * the non-zero values of sample `i` are found in
+  * `values[offsets[i]]` through `values[offsets[i + 1] - 1]`,
+  * and their positions in `indices` at the same offsets.
   */
 class dataset
 {
 public:
     int samples, dimensions, classes;
     double** X, ** Y;
+    double density;                                 /// Average fraction of non-zero inputs per sample
+    int* offsets, * indices;
+    double* values;
 
     ssize_t getline(char** lineptr, size_t* n, FILE* stream);
     void read_csv(const char* filename, int dataset_flag, double x_max);
+    void read_idx(const char* filename, int dataset_flag, double x_max);
+    void load(const char* filename, int dataset_flag, double x_max);
+    void place(void);
+    void encode_sparse(void);
     int get_label(int sample);
     void print_dataset(void);
 
@@ -46,16 +66,23 @@ public:
         samples{ samples }
     {
         dimensions = 0;
+        density = 1.0;
+        X = Y = nullptr;
+        offsets = indices = nullptr;
+        values = nullptr;
     }
 
     ~dataset()
     {
-        for (int i = 0; i < samples; i += 1)
+        for (int i = 0; X != nullptr && i < samples; i += 1)
         {
             delete[] X[i];
             delete[] Y[i];
         }
         delete[] X;
         delete[] Y;
+        delete[] offsets;
+        delete[] indices;
+        delete[] values;
     }
 };
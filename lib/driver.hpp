@@ -10,4 +10,7 @@
 
 #include "parser.hpp"
 #include "neural.hpp"
+#include "sweep.hpp"
+#include "score.hpp"
+#include "online.hpp"
 #include "interface.hpp"
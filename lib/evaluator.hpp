@@ -0,0 +1,92 @@
+/**
+ * evaluator.hpp
+ *
+ * In this header file, we define a
+ * background evaluator. At the end of
+ * every epoch, the training loop only
+ * copies the model's weights into a
+ * snapshot; a pool of threads scores the
+ * snapshots on a held-out dataset while
+ * the next epochs are being trained.
+ */
+
+#pragma once
+
+#include "common.hpp"
+#include "topology.hpp"
+
+#include <deque>                                    /// std::deque
+#include <mutex>                                    /// std::mutex
+#include <thread>                                   /// std::thread
+#include <condition_variable>                       /// std::condition_variable
+
+class nn;
+class dataset;
+
+/**
+ * Holds the weights of the model at the end of an epoch, waiting to be scored.
+ */
+struct evaluation_job
+{
+    int epoch;
+    std::vector<char> weights;
+};
+
+/**
+ * Holds the score of the model at the end of an epoch.
+ */
+struct evaluation_result
+{
+    int epoch;
+    double loss;
+    int validity;
+    double seconds;                                 /// Time spent scoring the snapshot
+};
+
+/**
+ * Implements a background evaluator.
+ *
+ * Every worker thread owns a replica of the model, with its
+ * own weights, activations and errors, so scoring a snapshot
+ * never touches the model being trained. The workers take the
+ * snapshots in epoch order, and print their scores as soon as
+ * they are done. A replica runs its kernels on a single thread,
+ * and the workers prefer the logical processors that are not
+ * used by the training's thread team.
+ */
+class evaluator
+{
+public:
+    int workers;                                    /// Number of worker threads (0 disables the evaluator)
+    bool active;
+    dataset* data;
+    size_t bytes;
+    std::vector<nn*> replicas;
+    std::vector<std::thread> pool;
+    std::deque<evaluation_job> jobs;
+    std::vector<evaluation_result> results;
+    std::mutex lock;
+    std::condition_variable wake;
+    bool stopping;
+
+    void open(nn& model, dataset(&HELD_OUT));
+    void submit(const void* parameters, int epoch);
+    void work(int worker);
+    void close(void);
+    void report(void);
+
+    evaluator() :
+        workers{ 0 },
+        active{ false },
+        data{ nullptr },
+        bytes{ 0 },
+        stopping{ false }
+    {
+
+    }
+
+    ~evaluator()
+    {
+        close();
+    }
+};
@@ -0,0 +1,62 @@
+/**
+ * freeze.hpp
+ *
+ * In this header file, we define a cache
+ * of the activations of the training
+ * samples. When the lower layers of a model
+ * are frozen, their outputs never change, so
+ * they are computed once per sample, and the
+ * later epochs train the layers above them
+ * on the cached activations only.
+ */
+
+#pragma once
+
+#include "arena.hpp"
+
+/**
+ * Implements the cache of the activations of a layer, one row per training sample.
+ *
+ * The developer calls `reserve` with the layer, the number of
+ * samples and the width of a row, then fills every row. The rows
+ * are handed out of a single mmap-backed arena, padded to a cache
+ * line each, so that a row is bound to the model in place of the
+ * layer's own activations, without a copy. A large cache is backed
+ * by (transparent) huge pages, like the model itself.
+ */
+class activation_cache
+{
+public:
+    int layer;                                      /// Layer whose activations are cached, or 0 (zero) if the cache is empty
+    int samples, width, pitch;                      /// Rows, the values of a row, and the doubles between two consecutive rows
+    arena memory;
+    double* rows;
+
+    void reserve(int layer, int samples, int width, int pitch);
+    void release(void);
+
+    inline double* row(int sample)
+    {
+        return rows + (size_t)sample * pitch;
+    }
+
+    inline size_t bytes(void) const
+    {
+        return (size_t)samples * pitch * sizeof(double);
+    }
+
+    activation_cache() :
+        layer{ 0 },
+        samples{ 0 },
+        width{ 0 },
+        pitch{ 0 },
+        rows{ nullptr }
+    {
+
+    }
+
+    ~activation_cache()
+    {
+        release();
+    }
+};
@@ -0,0 +1,65 @@
+/**
+ * idx.hpp
+ *
+ * In this header file, we define a
+ * reader of the IDX format, the format
+ * the MNIST and Fashion-MNIST datasets are
+ * originally distributed in. A file is
+ * mapped into memory, and its contents are
+ * read in place. A gzip-compressed file is
+ * inflated straight from the mapping.
+ */
+
+#pragma once
+
+#include "common.hpp"
+
+constexpr uint32_t IDX_LABELS_MAGIC = 0x00000801;   /// Declares the signature of an IDX file of unsigned bytes with 1 (one) dimension
+constexpr uint32_t IDX_IMAGES_MAGIC = 0x00000803;   /// Declares the signature of an IDX file of unsigned bytes with 3 (three) dimensions
+constexpr size_t IDX_INFLATE_CHUNK = 1 << 20;       /// Declares the bytes of compressed input handed to the inflater at once
+
+/**
+ * Implements a memory-mapped IDX file.
+ *
+ * The developer calls `open`, then reads the header
+ * through `word` and the values from `bytes`. If the
+ * file is raw, `bytes` points into the mapping, so the
+ * file is never copied. If the file is compressed with
+ * gzip, it is inflated in chunks into a single buffer
+ * sized after the gzip trailer, and the mapping is
+ * released right away.
+ */
+class idx_file
+{
+public:
+    std::string filepath;
+    unsigned char* mapped;                          /// Mapping of the whole file
+    size_t mapped_bytes;
+    std::vector<unsigned char> inflated;            /// Contents of the file, if it is compressed
+    const unsigned char* bytes;                     /// Contents of the file, header included
+    size_t size;
+    bool compressed;
+
+    void open(const char* filename);
+    void inflate(void);
+    uint32_t word(int index);
+    void close(void);
+
+    idx_file() :
+        mapped{ nullptr },
+        mapped_bytes{ 0 },
+        bytes{ nullptr },
+        size{ 0 },
+        compressed{ false }
+    {
+
+    }
+
+    ~idx_file()
+    {
+        close();
+    }
+};
+
+bool is_idx(const char* filename);
+std::string idx_labels_filepath(const std::string& images);
@@ -34,7 +34,8 @@ void restoreConsole(void);
 void getWindowSize(int(&rows), int(&columns));
 void getCursorPosition(int* row, int* col);
 void usage(char* filename);
-void print_epoch_stats(int epoch, double epoch_loss, int epoch_accuracy, double benchmark);
+void print_epoch_stats(int epoch, double epoch_loss, int epoch_accuracy, double benchmark, bool held_out = false);
+void print_input_stats(double density, bool sparse);
 
 void moveUp(int positions);
 void moveDown(int positions);
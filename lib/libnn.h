@@ -0,0 +1,167 @@
+/**
+ * libnn.h
+ *
+ * In this header file, we define the C
+ * interface of the project's library
+ * (`libnn.so` and `libnn.a`). The interface
+ * lets a program load or create a model,
+ * run batch inference straight on its own
+ * buffers, and train the model, without
+ * going through the `nn.out` driver.
+ *
+ * The interface only uses C types, and
+ * every model and workspace is an opaque
+ * handle, so the layout of the C++ classes
+ * can change without breaking the callers.
+ *
+ * Thread safety, per call:
+ *  - `nn_version()`, `nn_last_error()`,
+ *    `nn_input_size()` and `nn_output_size()`
+ *    are safe from any thread at any time.
+ *  - `nn_infer_f64()` and `nn_infer_f32()`
+ *    only read the model, so any number of
+ *    threads may run them on the same model
+ *    concurrently, as long as every thread
+ *    passes its own workspace (or none).
+ *    With a workspace, they never wait for
+ *    a lock, even while the model is being
+ *    reloaded. Without one, they only take
+ *    a short lock to register a temporary
+ *    workspace, which a reload never holds
+ *    while it waits for the readers.
+ *  - `nn_load_into()` swaps a new version of
+ *    the weights in, and may overlap any
+ *    number of inferences, and `nn_save()`.
+ *  - `nn_save()` reads the model, and must
+ *    not overlap a training.
+ *  - `nn_train_f64()` and `nn_destroy()`
+ *    modify the model, and must not overlap
+ *    any other call on the same model.
+ *  - Calls on different models never
+ *    interfere with each other.
+ */
+
+#ifndef LIBNN_H
+#define LIBNN_H
+
+#include <stddef.h>                                 /* size_t */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NN_API __attribute__((visibility("default")))
+
+#define NN_API_VERSION 1                            /* Version of the interface, bumped on every incompatible change */
+
+typedef struct nn_model nn_model;                   /* A model: its layers, weights and training state */
+typedef struct nn_workspace nn_workspace;           /* The activations of the inference of a single caller */
+
+/**
+ * Status codes returned by the calls that can fail. On failure,
+ * `nn_last_error()` describes the error on the calling thread.
+ */
+typedef enum nn_status
+{
+    NN_OK = 0,
+    NN_ERROR_ARGUMENT = 1,                          /* Invalid handle, size or pointer */
+    NN_ERROR_MEMORY = 2,                            /* Out of memory */
+    NN_ERROR_IO = 3                                 /* Unreadable, corrupted or unwritable file, or mismatched model */
+} nn_status;
+
+/**
+ * Returns `NN_API_VERSION` as compiled into the library.
+ */
+NN_API int nn_version(void);
+
+/**
+ * Returns the message of the last error on the calling thread, or an empty string.
+ */
+NN_API const char* nn_last_error(void);
+
+/**
+ * Creates a model with random weights.
+ *
+ * @param[in] sizes the number of neurons of every layer, from the input to the output (biases excluded)
+ * @param[in] count the number of layers (at least 3, since a hidden layer is required)
+ * @param[in] threads the number of threads of the model's kernels (0 uses all the logical processors)
+ * @param[out] model the new model
+ */
+NN_API nn_status nn_create(const int* sizes, int count, int threads, nn_model** model);
+
+/**
+ * Creates a model from a checkpoint written by `nn.out` (`-c`/`-C`) or by `nn_save()`.
+ *
+ * @param[in] filepath the checkpoint
+ * @param[in] threads the number of threads of the model's kernels (0 uses all the logical processors)
+ * @param[out] model the new model
+ */
+NN_API nn_status nn_load(const char* filepath, int threads, nn_model** model);
+
+/**
+ * Replaces the weights of a model with those of a checkpoint of a model with the same layers,
+ * without stopping the inferences.
+ *
+ * The checkpoint is loaded on the calling thread into a new version of the model, which is then
+ * published at once: an inference reads either the old weights or the new ones, never a mix. The
+ * call returns once every inference that started on the old version is done, and releases it.
+ * Serving threads are never blocked, so reload from a thread of your own.
+ */
+NN_API nn_status nn_load_into(nn_model* model, const char* filepath);
+
+/**
+ * Writes the weights of a model into a checkpoint, atomically.
+ */
+NN_API nn_status nn_save(const nn_model* model, const char* filepath);
+
+/**
+ * Releases a model. Its workspaces have to be released beforehand.
+ */
+NN_API void nn_destroy(nn_model* model);
+
+/**
+ * Returns the number of inputs of a sample, or the number of outputs of the model.
+ */
+NN_API int nn_input_size(const nn_model* model);
+NN_API int nn_output_size(const nn_model* model);
+
+/**
+ * Creates the workspace of a caller of `nn_infer_f64()` and `nn_infer_f32()` on a model.
+ * A workspace can be reused by the same caller for any number of calls, and is valid across
+ * the versions swapped in by `nn_load_into()`. It must not be used by two threads at once.
+ */
+NN_API nn_status nn_workspace_create(const nn_model* model, nn_workspace** workspace);
+NN_API void nn_workspace_destroy(nn_workspace* workspace);
+
+/**
+ * Feeds a batch of samples forward through the model.
+ *
+ * @param[in] model the model
+ * @param[in] inputs `batch` rows of `nn_input_size()` values, contiguous
+ * @param[in] batch the number of samples
+ * @param[out] outputs `batch` rows of `nn_output_size()` values, contiguous
+ * @param[in, out] workspace the caller's workspace, or `NULL` to allocate one for the call
+ *
+ * The inputs are read in place and the outputs are written in place: neither
+ * is copied. The samples are split across the model's threads.
+ */
+NN_API nn_status nn_infer_f64(const nn_model* model, const double* inputs, size_t batch, double* outputs, nn_workspace* workspace);
+NN_API nn_status nn_infer_f32(const nn_model* model, const float* inputs, size_t batch, float* outputs, nn_workspace* workspace);
+
+/**
+ * Trains the model on a batch of samples, one stochastic gradient descent step per sample, in order.
+ *
+ * @param[in, out] model the model
+ * @param[in] inputs `batch` rows of `nn_input_size()` values, contiguous
+ * @param[in] targets `batch` rows of `nn_output_size()` expected values, contiguous
+ * @param[in] batch the number of samples
+ * @param[in] learning_rate the learning rate of the steps
+ * @param[out] loss the average loss of the model over the batch, before every step (may be `NULL`)
+ */
+NN_API nn_status nn_train_f64(nn_model* model, const double* inputs, const double* targets, size_t batch, double learning_rate, double* loss);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
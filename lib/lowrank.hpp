@@ -0,0 +1,68 @@
+/**
+ * lowrank.hpp
+ *
+ * In this header file, we define a
+ * low-rank factorization of a dense
+ * matrix. The weights of a trained layer
+ * are decomposed with a truncated singular
+ * value decomposition into two thin
+ * matrices, so that the inference computes
+ * two small products instead of a large one.
+ */
+
+#pragma once
+
+#include "common.hpp"
+
+#include <numeric>                                  /// std::accumulate(), std::inner_product()
+
+constexpr int SVD_SWEEPS = 40;                      /// Declares the most sweeps of rotations of the decomposition
+constexpr double SVD_TOLERANCE = 1e-10;             /// Declares the cosine between two rows under which they count as orthogonal
+
+/**
+ * Implements the singular value decomposition of a dense matrix, truncated to a rank.
+ *
+ * The matrix `W` (`rows x columns`) is decomposed as `left * right`,
+ * where the `components` columns of `left` are the left singular
+ * vectors, and the rows of `right` are the right singular vectors
+ * scaled by their singular values, in decreasing order. Only the
+ * first `rank` components are used: row `j` of `right` is found at
+ * `right[j * columns]`, and row `i` of `left` at `left[i * components]`.
+ * `energy` holds the squared singular values, which add up to the
+ * squared Frobenius norm of the matrix.
+ */
+class low_rank
+{
+public:
+    int rows, columns, components, rank;
+    double* left, * right, * energy;
+    double* projected;                              /// Input projected onto the components, the scratch of the inference
+
+    void factorize(double** dense, int rows, int columns, int threads);
+    int rank_for(double kept) const;
+    void reconstruct(double** dense) const;
+    void release(void);
+
+    inline bool pays_off(void) const
+    {
+        return (size_t)rank * (rows + columns) < (size_t)rows * columns;                /// Fewer multiply-adds than the dense matrix
+    }
+
+    low_rank() :
+        rows{ 0 },
+        columns{ 0 },
+        components{ 0 },
+        rank{ 0 },
+        left{ nullptr },
+        right{ nullptr },
+        energy{ nullptr },
+        projected{ nullptr }
+    {
+
+    }
+
+    ~low_rank()
+    {
+        release();
+    }
+};
@@ -11,6 +11,30 @@
 #include "common.hpp"
 #include "dataset.hpp"
 #include "activation.hpp"
+#include "topology.hpp"
+#include "profiler.hpp"
+#include "trace.hpp"
+#include "arena.hpp"
+#include "sparse.hpp"
+#include "lowrank.hpp"
+#include "freeze.hpp"
+#include "selective.hpp"
+#include "checkpoint.hpp"
+#include "pipeline.hpp"
+#include "conv.hpp"
+#include "tuner.hpp"
+#include "evaluator.hpp"
+
+/**
+ * Kernels of an inference: the dense weights, the block-sparse weights of a pruned
+ * model, or the factors of a low-rank model.
+ */
+enum inference_kernels
+{
+    KERNELS_DENSE,
+    KERNELS_PRUNED,
+    KERNELS_FACTORED
+};
 
 /**
  * Implements a Multi Layer Perceptron model.
@@ -24,58 +48,129 @@
 class nn
 {
 public:
-    double** z, ** a, ** delta, *** weights;
+    double** a, ** delta, *** weights;
+    double* partial;                                        /// Partial sums of the errors propagated by every thread
+    size_t parameter_bytes;
+    arena memory;
+
+    int input_nnz;                                          /// Number of non-zero inputs bound, or -1 if the input is bound dense
+    int* input_index;
+    double* input_value;
+    bool sparse_input;
+
+    double sparsity;                                        /// Target fraction of pruned synapses after training (0 disables pruning)
+    block_sparse* pruned;                                   /// Block-sparse weights of every layer, once pruned
+    double retained;                                        /// Fraction of the spectral energy of every layer kept by a low-rank factorization after training (0 disables it)
+    int max_rank;                                           /// Highest rank of a factorized layer (0 does not cap it)
+    int fine_tune;                                          /// Epochs of training after the factorization
+    low_rank* factored;                                     /// Factors of every layer, once factorized
+
+    double learning_rate;
+    int epochs;
+    int threads;                                            /// Number of threads of the model's kernels (0 uses all the threads of the host)
+    int stages;                                             /// Number of pipeline stages of the training (1 disables the pipeline)
+    bool tune;                                              /// Tunes the kernels of every layer at `compile()`, through the tuning cache
+    std::vector<kernel_config> tuning;                      /// Configuration of the kernels of every weight matrix
+    std::vector<bool> frozen;                               /// Flag of every weight matrix whose weights the training leaves untouched
+    selective_sampler selective;                            /// Sampler that skips the backward passes of the easy samples, if given a floor
+    activation_cache cache;                                 /// Activations of the training samples at the top of the frozen layers, during a fit
+
+    checkpointer checkpoints;
+    evaluator held_out;                                     /// Scores the weights of every epoch in the background, if given workers
+    std::string resume_filepath;                            /// Checkpoint to resume the training from, if not empty
 
     std::vector<int> layers;
+    std::vector<feature_layer> features;                    /// Feature layers in front of the fully connected layers, if any
+    double** flat;                                          /// Output of the feature layers, one row per sample of a batch
 
     void set_layers(const std::vector<int>& l);
-    void set_z(const std::vector<int>& l);
+    int stride(int columns);
+    size_t footprint(const std::vector<int>& l);
     void set_a(const std::vector<int>& l);
     void set_delta(const std::vector<int>& l);
+    int widest(const std::vector<int>& l);
     void set_weights(const std::vector<int>& l, const double min, const double max);
     void compile(const std::vector<int>& l, const double min, const double max);
-    void zero_grad(double* (&X));
+    void snapshot(void* buffer);
+    void restore(const void* buffer);
+    void resume(const char* filename);
+    long load(const char* filename);
+    void bind_input(double* (&X));
+    void bind_input(dataset(&data), int sample);
+    void select_input_kernel(dataset(&data));
+    int plan(int matrix, int n, double cost);
+    int plan(int matrix, int n, double cost, kernel_strategy scheduling);
+    inline kernel_strategy strategy(int matrix, int team) const
+    {
+        return team > 1 ? tuning[matrix].strategy : STRATEGY_INLINE;
+    }
+    void autotune(void);
+    int set_features(void);
+    void set_feature_buffers(void);
+    void extract(double* const* X, int count);
+    void bind_sample(dataset(&data), int sample, bool streaming);
+    void backward_features(void);
     void forward(void);
+    void forward_from(int first);
+    int hidden_width(void) const;
+    template <typename T>
+    void forward_batch(const T* X, size_t batch, T* Y, double* scratch) const;
+    void propagate(int matrix, double* err, bool fused);
+    void output_error(double* (&Y));
     void back_propagation(double* (&Y));
+    void back_propagation_update(double* (&Y));
+    void update(int matrix);
+    int lowest_trainable(void) const;
+    void cache_frozen(dataset(&TRAIN));
     void optimize(void);
     int get_label(double* (&y_pred));
     int predict(double* (&X));
     double mse_loss(double* (&Y), int dim);
     int accuracy(double* (&Y), int dim);
-    void fit(dataset(&TRAIN));
+    void prune(double target);
+    void forward_pruned(void);
+    void factorize(double kept, int cap);
+    void refactorize(void);
+    void fine_tune_factored(dataset(&TRAIN), int epochs);
+    void forward_factored(void);
+    double infer(dataset(&data), inference_kernels kernels, double& loss, int& validity);
+    void pruning_report(dataset(&TEST));
+    void lowrank_report(dataset(&TRAIN), dataset(&TEST));
+    double train_epoch(dataset(&TRAIN), std::mt19937& gen, double& loss, int& validity);
+    void fit(dataset(&TRAIN), dataset* HELD_OUT = nullptr);
     void evaluate(dataset(&TEST));
     void export_weights(std::string filename);
     void summary(void);
+    void numa_summary(dataset(&TRAIN));
 
-    nn()
+    nn() :
+        partial{ nullptr },
+        parameter_bytes{ 0 },
+        input_nnz{ -1 },
+        input_index{ nullptr },
+        input_value{ nullptr },
+        sparse_input{ false },
+        sparsity{ 0.0 },
+        pruned{ nullptr },
+        retained{ 0.0 },
+        max_rank{ 0 },
+        fine_tune{ 0 },
+        factored{ nullptr },
+        learning_rate{ LEARNING_RATE },
+        epochs{ EPOCHS },
+        threads{ 0 },
+        stages{ 1 },
+        tune{ true },
+        flat{ nullptr }
     {
 
     }
 
     ~nn()
     {
-        for (int i = 0; i < layers.size(); i += 1)
-        {
-            delete[] z[i];
-            delete[] a[i];
-        }
-        delete[] z;
-        delete[] a;
-        for (int i = 0; i < layers.size() - 1; i += 1)
-        {
-            delete[] delta[i];
-        }
-        delete[] delta;
-        for (int i = 1; i < layers.size(); i += 1)
-        {
-            for (int j = 0; j < layers[i] - 1; j += 1)
-            {
-                delete[] weights[i - 1][j];
-            }
-            delete[] weights[i - 1];
-        }
-        delete[] weights;
-
+        delete[] pruned;
+        delete[] factored;
+        memory.release();                                   /// Releases every buffer of the model at once
         layers.clear();
         layers.shrink_to_fit();
     }
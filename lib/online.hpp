@@ -0,0 +1,114 @@
+/**
+ * online.hpp
+ *
+ * In this header file, we define an
+ * online learner. Labelled samples arrive
+ * continuously, on the standard input or on
+ * a Unix socket, and the model is updated
+ * with small mini-batches of whatever has
+ * arrived, so it stays fresh without whole
+ * training runs. The model is published as
+ * a checkpoint every now and then.
+ */
+
+#pragma once
+
+#include "neural.hpp"
+#include "score.hpp"
+
+#include <csignal>                                  /// sig_atomic_t
+
+constexpr int ONLINE_BATCH = 32;                    /// Declares the most samples of a single update, which bounds the latency of an update
+constexpr int ONLINE_QUEUE = 8 * ONLINE_BATCH;      /// Declares the samples buffered between the ingest and the training, which bounds the wait of a sample when the source outpaces the training
+constexpr size_t ONLINE_READ_BUFFER = 1 << 16;      /// Declares the bytes read from a source at once
+constexpr int ONLINE_POLL_MS = 100;                 /// Declares the interval at which an idle ingest checks for a stop request
+constexpr int ONLINE_BACKLOG = 16;                  /// Declares the connections of the socket waiting to be accepted
+constexpr double ONLINE_REPORT_SECONDS = 5.0;       /// Declares the seconds between the reports of the learner
+constexpr int ONLINE_SNAPSHOT_SECONDS = 10;         /// Declares the seconds between the published snapshots, unless '-c' or '-C' is given
+
+/**
+ * Holds a labelled sample, from its arrival to the update it is trained with.
+ */
+struct online_sample
+{
+    std::vector<double> x;
+    int label;
+    double arrival;                                 /// Time the sample was read off its source
+};
+
+/**
+ * Implements an online learner.
+ *
+ * The developer gives the model its options (`-c`, `-C`, `-r`, ...),
+ * then calls `open` with a source (`-` for the standard input, or the
+ * filepath of a Unix socket to listen on), `run` and `report`. The
+ * ingest thread parses the rows of the source into recycled sample
+ * slots. The training thread takes whatever samples have arrived, up to
+ * `ONLINE_BATCH`, and trains on them one after the other, like a step of
+ * `fit()`; it never waits for a batch to fill up. Every sample is scored
+ * before it is trained on, so the reported accuracy is that of the model
+ * on samples it has not seen yet.
+ *
+ * The rows have the layout of the training CSV files: the label, then
+ * the pixels. Headers are skipped. The standard input is learned from
+ * until it ends; a socket serves any number of clients at once, until
+ * the learner is interrupted (SIGINT or SIGTERM). The last model is
+ * published before the learner returns.
+ */
+class learner
+{
+public:
+    nn model;
+    std::string source;
+    int listener;                                   /// Listening socket, or -1 for the standard input
+    std::vector<double> target;                     /// One-hot output of the sample being trained on
+
+    std::vector<online_sample> slots;
+    bounded_queue<online_sample*> empty, ready;
+    std::thread reader;
+
+    long received, malformed, samples, updates;
+    double start, seconds;
+    double latency_sum, latency_max;
+
+    std::vector<double> latencies;                  /// Latencies of the samples of the current report
+    long window_samples, window_updates;
+    int window_correct;
+    double window_loss, window_start;
+
+    void open(const char* source_name, const std::vector<int>& l);
+    void listen(const char* path);
+    void ingest(void);
+    void consume(std::string& pending);
+    void update(std::vector<online_sample*>& batch);
+    void run(void);
+    void report_window(double now);
+    void report(void);
+    void close(void);
+
+    learner() :
+        listener{ -1 },
+        empty{ ONLINE_QUEUE },
+        ready{ ONLINE_QUEUE },
+        received{ 0 },
+        malformed{ 0 },
+        samples{ 0 },
+        updates{ 0 },
+        start{ 0.0 },
+        seconds{ 0.0 },
+        latency_sum{ 0.0 },
+        latency_max{ 0.0 },
+        window_samples{ 0 },
+        window_updates{ 0 },
+        window_correct{ 0 },
+        window_loss{ 0.0 },
+        window_start{ 0.0 }
+    {
+
+    }
+
+    ~learner()
+    {
+        close();
+    }
+};
@@ -12,6 +12,8 @@
 #pragma once
 
 #include "interface.hpp"
+#include "topology.hpp"
+#include "neural.hpp"
 
 int parse_integer(char* argv);
-void parse_arguments(int argc, char* argv[], std::vector<int>& vec);
+void parse_arguments(int argc, char* argv[], std::vector<int>& vec, nn& model, std::string* sources = nullptr);
@@ -0,0 +1,84 @@
+/**
+ * pipeline.hpp
+ *
+ * In this header file, we define a
+ * layer-wise pipeline for the training.
+ * The layers of the model are split into
+ * contiguous stages, and every stage is run
+ * by its own group of threads. The samples
+ * stream through the stages one after the
+ * other, so that all stages are busy with
+ * different samples at the same time.
+ */
+
+#pragma once
+
+#include "common.hpp"
+#include "arena.hpp"
+#include "topology.hpp"
+
+#include <atomic>                                   /// std::atomic
+
+class nn;
+class dataset;
+
+/**
+ * Holds the progress of a stage, on its own cache line.
+ */
+struct alignas(64) stage_progress
+{
+    std::atomic<long> forwarded;                    /// Number of samples fed forward through the stage
+    std::atomic<long> backwarded;                   /// Number of samples propagated back through the stage
+};
+
+/**
+ * Implements a pipeline with a 1F1B (one forward, one backward) schedule.
+ *
+ * Stage `s` owns the weight matrices `first[s]` through
+ * `first[s + 1] - 1`. Up to `stages` samples are in flight at
+ * once, each in its own slot of activations and errors. After a
+ * warm-up of `stages - s - 1` forwards, stage `s` alternates a
+ * forward of a new sample with a backward of its oldest one, and
+ * updates its weights right after every backward. Since the
+ * weights change while a sample is in flight, every forward
+ * stashes the stage's weights in the sample's slot, and the
+ * backward of that sample propagates the errors through the
+ * stashed weights (weight stashing). The updates are applied to
+ * the latest weights, in the same pass over the rows.
+ */
+class pipeline
+{
+public:
+    int stages, group;                              /// Number of stages, and threads per stage
+    std::vector<int> first;
+    std::vector<size_t> offset, bytes;              /// Offset of the stage's weights in the parameter region, and their size
+    double*** a, *** delta;                         /// Activations and errors of every slot
+    double** stash;                                 /// Stashed weights of every stage and slot
+    double* partial;                                /// Partial sums of the errors, a row of `width` per thread of every stage
+    int width;
+    stage_progress* progress;
+    arena memory;
+
+    void build(nn& model, int requested);
+    void forward(nn& model, int stage, int slot);
+    void backward(nn& model, int stage, int slot, double* Y);
+    double train_epoch(nn& model, dataset(&TRAIN), std::mt19937& gen, double& loss, int& validity);
+
+    pipeline() :
+        stages{ 0 },
+        group{ 1 },
+        a{ nullptr },
+        delta{ nullptr },
+        stash{ nullptr },
+        partial{ nullptr },
+        width{ 0 },
+        progress{ nullptr }
+    {
+
+    }
+
+    ~pipeline()
+    {
+        delete[] progress;
+    }
+};
@@ -0,0 +1,175 @@
+/**
+ * profiler.hpp
+ *
+ * In this header file, we define the
+ * instrumentation of the training step.
+ * Every phase of the step is timed using
+ * the processor's time stamp counter, and
+ * the elapsed cycles are accumulated into
+ * counters private to each thread. When the
+ * host allows it, the profiler also reads
+ * the instruction, cache miss and floating
+ * point operation counters of the processor
+ * through `perf_event_open`. The whole
+ * instrumentation compiles out, unless the
+ * project is built with `NN_PROFILE` defined.
+ */
+
+#pragma once
+
+#include "common.hpp"
+#include "tuner.hpp"
+
+#include <mutex>                                    /// std::mutex
+#include <chrono>                                   /// std::chrono::steady_clock
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>                              /// __rdtsc()
+#endif
+
+/**
+ * Phases of the training step monitored by the profiler.
+ */
+enum profile_phase
+{
+    PHASE_FORWARD,
+    PHASE_BACK_PROPAGATION,
+    PHASE_OPTIMIZE,
+    PHASE_LOSS,
+    PHASE_ACCURACY,
+    N_PHASES
+};
+
+/**
+ * Hardware events read by the profiler.
+ */
+enum profile_event
+{
+    EVENT_INSTRUCTIONS,
+    EVENT_CACHE_MISSES,
+    EVENT_FLOPS,
+    N_EVENTS
+};
+
+constexpr int PROFILE_MAX_LAYERS = 16;              /// Declares the number of layers monitored separately (deeper layers share the last slot)
+constexpr int PROFILE_MAX_PERF_EVENTS = 6;          /// Declares the number of raw events opened per thread
+
+/**
+ * Holds the counters of a single thread. The counters are
+ * aligned to a cache line, so that threads never share one.
+ */
+struct alignas(64) profile_counters
+{
+    uint64_t cycles[N_PHASES][PROFILE_MAX_LAYERS];
+    uint64_t calls[N_PHASES][PROFILE_MAX_LAYERS];
+    uint64_t events[N_PHASES][PROFILE_MAX_LAYERS][N_EVENTS];
+    uint64_t strategies[N_PHASES][PROFILE_MAX_LAYERS][N_STRATEGIES];
+};
+
+/**
+ * Implements the profiler of the project.
+ *
+ * Every thread that enters a monitored phase registers a set
+ * of counters with the profiler on its first use. At the end of
+ * `fit()` and `evaluate()`, the counters of all threads are
+ * aggregated and printed as a per-phase breakdown.
+ *
+ * @note    Hardware counters are opt-in, by setting the `NN_PERF_EVENTS`
+ *          environment variable. Reading them costs a system call per
+ *          thread at every phase boundary, which is far from free.
+ */
+class profiler
+{
+public:
+    std::vector<profile_counters*> counters;
+    std::vector<int> perf_groups;                   /// Leader of the event group of each OpenMP thread
+    std::vector<std::vector<int>> perf_fds;         /// Every event of the group of each OpenMP thread, the leader first
+    std::vector<int> perf_kinds;                    /// Kind of each event in a group, weighted by its floating point operations
+    std::mutex lock;
+    bool hardware;
+    uint64_t start_ticks;
+    std::chrono::steady_clock::time_point start_time;
+
+    static inline uint64_t ticks(void)
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+    }
+
+    profile_counters& local(void);
+    void enable_hardware(int threads);
+    void disable_hardware(void);
+    void read_hardware(uint64_t(&values)[N_EVENTS]);
+    void report(const char* title);
+    void reset(void);
+
+    profiler() :
+        hardware{ false }
+    {
+        start_ticks = ticks();
+        start_time = std::chrono::steady_clock::now();
+    }
+
+    ~profiler();
+};
+
+extern profiler prof;                               /// Declares the profiler of the project
+
+/**
+ * Monitors a phase for as long as the instance lives.
+ */
+class profile_scope
+{
+public:
+    profile_counters& counters;
+    int phase, layer;
+    uint64_t begin;
+    uint64_t events[N_EVENTS];
+
+    profile_scope(int phase, int layer) :
+        counters{ prof.local() },
+        phase{ phase },
+        layer{ layer < PROFILE_MAX_LAYERS ? layer : PROFILE_MAX_LAYERS - 1 }
+    {
+        if (prof.hardware)
+        {
+            prof.read_hardware(events);
+        }
+        begin = profiler::ticks();
+    }
+
+    ~profile_scope()
+    {
+        counters.cycles[phase][layer] += profiler::ticks() - begin;
+        counters.calls[phase][layer] += 1;
+        if (prof.hardware)
+        {
+            uint64_t end[N_EVENTS];
+            prof.read_hardware(end);
+            for (int i = 0; i < N_EVENTS; i += 1)
+            {
+                counters.events[phase][layer][i] += end[i] - events[i];
+            }
+        }
+    }
+};
+
+#define PROFILE_CONCAT_(x, y) x##y
+#define PROFILE_CONCAT(x, y) PROFILE_CONCAT_(x, y)
+
+#ifdef NN_PROFILE
+#define PROFILE_SCOPE(phase, layer) profile_scope PROFILE_CONCAT(profile_scope_, __LINE__)(phase, layer)
+#define PROFILE_STRATEGY(phase, layer, strategy) prof.local().strategies[phase][(layer) < PROFILE_MAX_LAYERS ? (layer) : PROFILE_MAX_LAYERS - 1][strategy] += 1
+#define PROFILE_HARDWARE(threads) prof.enable_hardware(threads)
+#define PROFILE_REPORT(title) prof.report(title)
+#define PROFILE_RESET() prof.reset()
+#else
+#define PROFILE_SCOPE(phase, layer)
+#define PROFILE_STRATEGY(phase, layer, strategy)
+#define PROFILE_HARDWARE(threads)
+#define PROFILE_REPORT(title)
+#define PROFILE_RESET()
+#endif
@@ -0,0 +1,175 @@
+/**
+ * score.hpp
+ *
+ * In this header file, we define a
+ * batch scorer. A saved model scores a
+ * CSV file through a pipeline of three
+ * stages, each one on its own thread: a
+ * parser, the model's forward pass, and a
+ * writer of the predicted labels and their
+ * probabilities. The batches are recycled,
+ * so the file is streamed in constant
+ * memory, whatever its size.
+ */
+
+#pragma once
+
+#include "neural.hpp"
+
+#include <deque>                                    /// std::deque
+#include <mutex>                                    /// std::mutex
+#include <thread>                                   /// std::thread
+#include <condition_variable>                       /// std::condition_variable
+
+constexpr int SCORE_BATCH = 256;                    /// Declares the number of rows fed forward at once
+constexpr int SCORE_DEPTH = 4;                      /// Declares the number of batches in flight, which bounds the memory of the pipeline
+constexpr size_t SCORE_IO_BUFFER = 1 << 20;         /// Declares the size of the buffers of the input and the output streams
+
+/**
+ * Implements a blocking queue of bounded capacity between two stages of a pipeline.
+ *
+ * `push` blocks while the queue is full, and `pop` blocks while it is empty, while
+ * `try_pop` returns `false` right away. Once the producer calls `close`, `pop` drains
+ * the queue and then returns `false`.
+ */
+template <typename T>
+class bounded_queue
+{
+public:
+    std::deque<T> items;
+    size_t capacity;
+    bool closed;
+    std::mutex lock;
+    std::condition_variable not_empty, not_full;
+
+    void push(T item)
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        not_full.wait(guard, [this]() { return items.size() < capacity; });
+        items.push_back(std::move(item));
+        not_empty.notify_one();
+    }
+
+    bool pop(T& item)
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        not_empty.wait(guard, [this]() { return closed || !items.empty(); });
+        if (items.empty())
+        {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+
+    bool try_pop(T& item)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (items.empty())
+        {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+
+    void close(void)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        closed = true;
+        not_empty.notify_all();
+    }
+
+    bounded_queue(size_t capacity) :
+        capacity{ capacity },
+        closed{ false }
+    {
+
+    }
+};
+
+/**
+ * Holds a batch of rows, from their parsed inputs to their predicted probabilities.
+ */
+struct score_batch
+{
+    int rows;
+    std::vector<double> X, P;                       /// Inputs and outputs of the rows, contiguous
+    std::vector<int> labels;                        /// Expected labels of the rows, if the file has any (-1 otherwise)
+};
+
+/**
+ * Implements a batch scorer.
+ *
+ * The developer calls `open` with a checkpoint, an input file and
+ * an output file (`-` for the standard streams), then `run` and
+ * `report`. The parser takes an empty batch, fills it with the next
+ * rows of the input, and hands it to the forward stage, which hands
+ * it to the writer, which returns it to the parser. The forward stage
+ * runs on the calling thread, with the model's thread team.
+ *
+ * The input has the layout of the training CSV files: an optional
+ * header, an optional label column, and the pixels of a sample per
+ * row. If the rows are labelled, the accuracy is reported too.
+ */
+class scorer
+{
+public:
+    nn model;
+    FILE* input, * output;
+    std::string input_filepath, output_filepath;
+    bool labelled;
+    int columns;                                    /// Number of values of a row of the input
+    std::string pending;                            /// First row of the input, if it is not a header
+
+    std::vector<score_batch> batches;
+    bounded_queue<score_batch*> empty, parsed, scored;
+    std::vector<double> scratch;                    /// Scratch buffer of the forward stage
+
+    long rows, malformed, correct;
+    double parse_time, forward_time, write_time, seconds;
+
+    void open(const char* checkpoint, const char* input_file, const char* output_file);
+    bool parse_row(char* line, score_batch& batch);
+    void parse(void);
+    void write(void);
+    void run(void);
+    void report(void);
+
+    scorer() :
+        input{ nullptr },
+        output{ nullptr },
+        labelled{ false },
+        columns{ 0 },
+        empty{ SCORE_DEPTH },
+        parsed{ SCORE_DEPTH },
+        scored{ SCORE_DEPTH },
+        rows{ 0 },
+        malformed{ 0 },
+        correct{ 0 },
+        parse_time{ 0.0 },
+        forward_time{ 0.0 },
+        write_time{ 0.0 },
+        seconds{ 0.0 }
+    {
+
+    }
+
+    ~scorer()
+    {
+        if (input != nullptr && input != stdin)
+        {
+            fclose(input);
+        }
+        if (output != nullptr && output != stdout)
+        {
+            fclose(output);
+        }
+    }
+};
+
+bool parse_sample(char* line, int columns, bool labelled, double* x, int& label);
@@ -0,0 +1,63 @@
+/**
+ * selective.hpp
+ *
+ * In this header file, we define a
+ * sampler of the backward passes. Late in
+ * the training, most samples are already
+ * classified confidently, so the loss of
+ * their forward pass decides whether their
+ * backward pass is worth its cost. The
+ * passes that are kept are weighted up, so
+ * that the expected update is unchanged.
+ */
+
+#pragma once
+
+#include "common.hpp"
+
+constexpr double SELECTIVE_LOSS = 0.05;             /// Declares the loss from which the backward pass of a sample is always kept
+
+/**
+ * Implements the loss-aware sampler of the backward passes.
+ *
+ * The developer sets `floor`, the lowest probability of a backward
+ * pass, and calls `weigh` with the loss of every forward pass. The
+ * backward pass is kept with probability `sqrt(loss / SELECTIVE_LOSS)`,
+ * clamped between `floor` and 1 (one): the error of the output layer,
+ * and so the norm of the gradient, grows with the square root of the
+ * loss, so the samples are kept in proportion to the step they would
+ * take. Samples that are not fitted yet are always trained on, so
+ * nothing is skipped early in the training. A kept pass is weighted
+ * by the inverse of its probability, so the expected step of every
+ * sample is that of a plain epoch, and the weights stay bounded by
+ * `1 / floor`. `end_epoch` closes the counters of an epoch, which
+ * `report` prints.
+ */
+class selective_sampler
+{
+public:
+    double floor;                                   /// Lowest probability of a backward pass, or 0 (zero) if every pass is kept
+
+    long seen, kept;                                /// Forward and backward passes of the current epoch
+    double weights;                                 /// Sum of the weights of the kept passes of the current epoch
+    std::vector<long> epoch_seen, epoch_kept;
+    std::vector<double> epoch_weights;
+
+    double weigh(double loss, std::mt19937& gen);
+    void end_epoch(void);
+    void report(void);
+
+    inline bool active(void) const
+    {
+        return floor > 0.0;
+    }
+
+    selective_sampler() :
+        floor{ 0.0 },
+        seen{ 0 },
+        kept{ 0 },
+        weights{ 0.0 }
+    {
+
+    }
+};
@@ -0,0 +1,50 @@
+/**
+ * sparse.hpp
+ *
+ * In this header file, we define a
+ * block-sparse matrix. After pruning,
+ * the surviving synapses of a layer are
+ * kept as short dense blocks, so that the
+ * inference kernels stream them with SIMD
+ * and skip the pruned blocks altogether.
+ */
+
+#pragma once
+
+#include "common.hpp"
+
+/**
+ * Implements a Block Sparse Row (BSR) matrix with `1 x PRUNE_BLOCK` blocks.
+ *
+ * The blocks of row `i` are found in `offsets[i]` through
+ * `offsets[i + 1] - 1`. Block `b` starts at column `starts[b]`,
+ * and its `PRUNE_BLOCK` values are found at `values[b * PRUNE_BLOCK]`.
+ * Only the first `blocked` columns of the dense matrix are encoded;
+ * the remaining columns (fewer than `PRUNE_BLOCK`) stay dense.
+ */
+class block_sparse
+{
+public:
+    int rows, blocked, blocks;
+    int* offsets, * starts;
+    double* values;
+
+    void compress(double** dense, int rows, int columns);
+    void release(void);
+
+    block_sparse() :
+        rows{ 0 },
+        blocked{ 0 },
+        blocks{ 0 },
+        offsets{ nullptr },
+        starts{ nullptr },
+        values{ nullptr }
+    {
+
+    }
+
+    ~block_sparse()
+    {
+        release();
+    }
+};
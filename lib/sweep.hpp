@@ -0,0 +1,86 @@
+/**
+ * sweep.hpp
+ *
+ * In this header file, we define a
+ * hyperparameter sweep. The datasets are
+ * loaded once and shared, read-only, by
+ * many models trained concurrently, each
+ * with its own share of the threads. Poor
+ * performers are cut early with successive
+ * halving, and the surviving models are
+ * ranked in a results table.
+ */
+
+#pragma once
+
+#include "neural.hpp"
+
+#include <sstream>                                  /// std::stringstream
+
+constexpr int SWEEP_ETA = 2;                        /// Declares the fraction (1 / SWEEP_ETA) of trials that survive a rung of successive halving
+constexpr int SWEEP_MIN_EPOCHS = 1;                 /// Declares the epochs every trial is trained for in the first rung
+
+/**
+ * Holds the configuration and the progress of a single trial of the sweep.
+ */
+class trial
+{
+public:
+    std::vector<int> hidden;
+    double learning_rate;
+    int epochs;
+
+    int trained, rung;                              /// Epochs trained so far, and the last rung the trial took part in
+    int validity, best;                             /// Last and best number of correctly classified evaluation samples
+    double loss, seconds, seconds_to_best;          /// Last evaluation loss, training time so far, and training time to the best accuracy
+    bool alive;
+    std::mt19937 gen;
+    nn* model;
+
+    trial(const std::vector<int>& hidden, double learning_rate, int epochs) :
+        hidden{ hidden },
+        learning_rate{ learning_rate },
+        epochs{ epochs },
+        trained{ 0 },
+        rung{ 0 },
+        validity{ 0 },
+        best{ -1 },
+        loss{ 0.0 },
+        seconds{ 0.0 },
+        seconds_to_best{ 0.0 },
+        alive{ true },
+        model{ nullptr }
+    {
+
+    }
+};
+
+/**
+ * Implements a hyperparameter sweep with successive halving.
+ *
+ * The developer calls `load` with a configuration file,
+ * then `run` with the shared datasets, and then `report`.
+ * Every line of the configuration file holds the hidden
+ * layers (comma separated), the learning rate and the epochs
+ * of a trial. Any field may list alternatives separated by
+ * `|`, in which case the line expands to the grid of all
+ * combinations. Lines starting with `#` are ignored.
+ */
+class sweep
+{
+public:
+    std::vector<trial> trials;
+
+    void load(const char* filename);
+    void train_rung(dataset(&TRAIN), dataset(&TEST), std::vector<int>& survivors, int budget);
+    void run(dataset(&TRAIN), dataset(&TEST));
+    void report(int samples);
+
+    ~sweep()
+    {
+        for (auto& t : trials)
+        {
+            delete t.model;
+        }
+    }
+};
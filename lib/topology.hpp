@@ -0,0 +1,75 @@
+/**
+ * topology.hpp
+ *
+ * In this header file, we define a
+ * class that describes the host's processor
+ * topology. The class detects the number of
+ * logical processors available to the process
+ * and the NUMA node that each one of them
+ * belongs to. It then pins the OpenMP threads
+ * to logical processors according to an
+ * explicit affinity policy, so that memory
+ * first touched by a thread stays on the node
+ * of the thread that consumes it.
+ */
+
+#pragma once
+
+#include "common.hpp"
+
+#ifdef __linux__
+#include <sched.h>                                  /// sched_setaffinity()
+#include <unistd.h>                                 /// sysconf()
+#include <sys/syscall.h>                            /// SYS_move_pages
+#endif
+
+/**
+ * Affinity policies supported by the project.
+ *
+ * `AFFINITY_COMPACT` fills the logical processors of a node
+ * before moving on to the next one, while `AFFINITY_SCATTER`
+ * distributes consecutive threads round robin across the nodes.
+ * `AFFINITY_NONE` leaves the placement of the threads to the OS.
+ */
+enum affinity_policy
+{
+    AFFINITY_NONE,
+    AFFINITY_COMPACT,
+    AFFINITY_SCATTER
+};
+
+/**
+ * Implements the description of the host's topology.
+ *
+ * The developer sets `threads` and `policy` (usually through
+ * the command line), then calls `detect` to fill in the rest
+ * of the attributes and `bind` to pin the OpenMP thread team.
+ * If `threads` is 0 (zero), the number of threads is set to the
+ * number of logical processors available to the process.
+ */
+class topology
+{
+public:
+    int threads, nodes;
+    affinity_policy policy;
+    std::vector<int> cpus;                          /// Logical processors available to the process
+    std::vector<int> cpu_node;                      /// NUMA node of each logical processor in `cpus`
+    std::vector<int> thread_cpu;                    /// Logical processor assigned to each OpenMP thread
+
+    void detect(void);
+    void bind(void);
+    int thread_node(int thread);
+    int page_node(const void* addr);
+    double remote_bytes(const void* addr, size_t bytes, int node);
+    const char* policy_name(void);
+
+    topology() :
+        threads{ N_THREADS },
+        nodes{ 1 },
+        policy{ AFFINITY_COMPACT }
+    {
+
+    }
+};
+
+extern topology host;                               /// Declares the topology of the machine that runs the project
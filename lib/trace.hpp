@@ -0,0 +1,136 @@
+/**
+ * trace.hpp
+ *
+ * In this header file, we define a
+ * timeline tracer. Every thread records
+ * the begin and the end of the regions
+ * it executes into a ring buffer private
+ * to that thread, without any locks. On
+ * exit, the buffers of all threads are
+ * exported as a Chrome trace-event JSON
+ * document, which can be opened with
+ * `chrome://tracing` or Perfetto to spot
+ * idle threads and stragglers. The whole
+ * tracer compiles out, unless the project
+ * is built with `NN_TRACE` defined.
+ */
+
+#pragma once
+
+#include "common.hpp"
+
+#include <atomic>                                   /// std::atomic
+#include <chrono>                                   /// std::chrono::steady_clock
+
+constexpr int TRACE_BUFFER_EVENTS = 1 << 18;        /// Declares the capacity of a thread's ring buffer (must be a power of 2)
+constexpr char TRACE_DEFAULT_FILEPATH[] = "./build/trace.json";
+                                                    /// Declares the filepath of the timeline, unless `NN_TRACE` is set in the environment
+
+/**
+ * Holds a complete event (a region with a begin and an end).
+ */
+struct trace_event
+{
+    const char* name;
+    const char* category;
+    int arg;
+    uint64_t begin, end;
+};
+
+/**
+ * Implements the ring buffer of a single thread.
+ *
+ * Only the owner thread writes into the buffer. When the
+ * buffer is full, the oldest events are overwritten.
+ */
+class trace_buffer
+{
+public:
+    trace_event* events;
+    std::atomic<uint64_t> head;
+    int tid, omp_tid;
+    trace_buffer* next;
+
+    trace_buffer(int tid, int omp_tid) :
+        head{ 0 },
+        tid{ tid },
+        omp_tid{ omp_tid },
+        next{ nullptr }
+    {
+        events = new trace_event[TRACE_BUFFER_EVENTS];
+    }
+
+    ~trace_buffer()
+    {
+        delete[] events;
+    }
+};
+
+/**
+ * Implements the tracer of the project.
+ *
+ * Threads register their buffers on their first event by
+ * pushing them onto a lock-free list. The timeline is
+ * written when the tracer is destroyed, on program exit.
+ */
+class tracer
+{
+public:
+    std::atomic<trace_buffer*> buffers;
+    std::atomic<int> registered;
+    std::chrono::steady_clock::time_point origin;
+
+    static inline uint64_t now(void)
+    {
+        return std::chrono::steady_clock::now().time_since_epoch().count();
+    }
+
+    trace_buffer& local(void);
+    void record(const char* name, const char* category, int arg, uint64_t begin, uint64_t end);
+    void export_timeline(const char* filename);
+
+    tracer() :
+        buffers{ nullptr },
+        registered{ 0 }
+    {
+        origin = std::chrono::steady_clock::now();
+    }
+
+    ~tracer();
+};
+
+extern tracer timeline;                             /// Declares the tracer of the project
+
+/**
+ * Records a region for as long as the instance lives.
+ */
+class trace_scope
+{
+public:
+    const char* name;
+    const char* category;
+    int arg;
+    uint64_t begin;
+
+    trace_scope(const char* name, const char* category, int arg) :
+        name{ name },
+        category{ category },
+        arg{ arg }
+    {
+        begin = tracer::now();
+    }
+
+    ~trace_scope()
+    {
+        timeline.record(name, category, arg, begin, tracer::now());
+    }
+};
+
+#define TRACE_CONCAT_(x, y) x##y
+#define TRACE_CONCAT(x, y) TRACE_CONCAT_(x, y)
+
+#ifdef NN_TRACE
+#define TRACE_SCOPE(name, category, arg) trace_scope TRACE_CONCAT(trace_scope_, __LINE__)(name, category, arg)
+#else
+#define TRACE_SCOPE(name, category, arg)
+#endif
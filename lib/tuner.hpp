@@ -0,0 +1,108 @@
+/**
+ * tuner.hpp
+ *
+ * In this header file, we define the
+ * configuration of the kernels of a layer
+ * and the persistent cache of the tuned
+ * configurations. The fastest configuration
+ * depends on the shape of the layer and on
+ * the host, so the configurations are tuned
+ * once per processor model and layer shape,
+ * and reloaded by every later run.
+ */
+
+#pragma once
+
+#include "common.hpp"
+
+#include <map>                                      /// std::map
+
+constexpr int TUNE_STEPS = 16;                      /// Declares the number of training steps timed per measurement of a configuration
+constexpr int TUNE_REPEATS = 3;                     /// Declares the number of measurements of a configuration, of which the fastest is kept
+constexpr int TUNE_GRAINS[] = { 1, 4, 16 };         /// Declares the candidate numbers of chunks per thread of a kernel's loop
+constexpr char TUNING_DEFAULT_FILEPATH[] = "./build/tuning.nnt";
+                                                    /// Declares the filepath of the tuning cache
+constexpr double PARALLEL_MIN_WORK = 16384.0;       /// Declares the multiply-adds a thread has to be given for waking it up to pay off
+constexpr double DYNAMIC_CHUNK_WORK = 4096.0;       /// Declares the multiply-adds of a chunk taken at once by a thread of a dynamic schedule
+
+/**
+ * Strategies of an invocation of a kernel.
+ *
+ * `STRATEGY_INLINE` runs the kernel on the calling thread, without
+ * waking the thread team up. `STRATEGY_STATIC` splits the loop into
+ * equal chunks, fixed ahead of time, while with `STRATEGY_DYNAMIC`
+ * the threads take the next chunk off a shared counter as soon as they
+ * are done with the previous one, so a slow thread never holds the rest
+ * of the team back.
+ */
+enum kernel_strategy
+{
+    STRATEGY_INLINE,
+    STRATEGY_STATIC,
+    STRATEGY_DYNAMIC,
+    N_STRATEGIES
+};
+
+constexpr const char* strategy_names[N_STRATEGIES] = { "inline", "static", "dynamic" };
+
+/**
+ * Implements the configuration of the kernels of a weight matrix.
+ *
+ * The `forward()`, `back_propagation()` and `optimize()` loops
+ * over the matrix run on up to `threads` threads, and are split
+ * according to `strategy`: dynamically, into chunks sized after
+ * their cost, or statically, into `grain` chunks per thread. An
+ * invocation with too little work for its threads runs on fewer
+ * threads, or inline (see `nn::plan()`), and a single thread runs
+ * every invocation inline. The default is static, a chunk per thread,
+ * which is the partition the weights are first touched with (see
+ * `nn::set_weights()`); the tuner may pick a dynamic schedule instead.
+ */
+class kernel_config
+{
+public:
+    int threads;
+    int grain;
+    kernel_strategy strategy;
+
+    kernel_config(int threads = 1, int grain = 1, kernel_strategy strategy = STRATEGY_STATIC) :
+        threads{ threads },
+        grain{ grain },
+        strategy{ strategy }
+    {
+
+    }
+};
+
+/**
+ * Implements the tuning cache of the host.
+ *
+ * Every line of the file holds a processor model, the number of
+ * threads the model was given, the shape of a weight matrix and
+ * the tuned configuration of its kernels (threads, grain and
+ * strategy), separated by tabs. An entry without a strategy is
+ * static.
+ * Entries of other hosts are kept as is, so a single file can be
+ * shared across machines.
+ */
+class tuning_cache
+{
+public:
+    std::string filepath;
+    std::string cpu;                                /// Processor model of the host
+    std::map<std::string, kernel_config> entries;
+
+    std::string key(int threads, int rows, int columns);
+    void load(void);
+    bool find(int threads, int rows, int columns, kernel_config& config);
+    void store(int threads, int rows, int columns, const kernel_config& config);
+    void save(void);
+
+    tuning_cache() :
+        filepath{ TUNING_DEFAULT_FILEPATH }
+    {
+
+    }
+};
+
+std::string cpu_model(void);
@@ -1,6 +1,115 @@
 
 #include "driver.hpp"
 
+/**
+ * Implements the `sweep` mode of the driver. The datasets are loaded once and shared
+ * by all the trials of the sweep, which are trained concurrently.
+ *
+ * @param[in] argc number of user arguments
+ * @param[in] argv vector of user arguments, i.e. `nn.out sweep <configurations> [options]`
+ *
+ * @return 0, if the sweep was completed normally
+ *
+ * @note    Only the `-t`, `-a`, `-d` and `-D` options apply to a sweep. The threads are shared by the trials.
+ */
+int sweep_main(int argc, char* argv[])
+{
+    std::vector<int> vec;
+    std::string sources[2] = { TRAINING_DATA_FILEPATH, EVALUATION_DATA_FILEPATH };
+    nn settings;                                                                                    /// Receives the model options, which the sweep ignores
+    sweep search;
+    dataset TRAIN(MNIST_CLASSES, MNIST_TRAIN);
+    dataset TEST(MNIST_CLASSES, MNIST_TEST);
+
+    if (argc < 3)
+    {
+        usage(argv[0]);
+    }
+    search.load(argv[2]);                                                                           /// Loads the trials before any dataset
+    argv[2] = argv[0];                                                                              /// Parses the options that follow the configurations
+    parse_arguments(argc - 2, argv + 2, vec, settings, sources);
+    host.detect();
+    host.bind();
+
+    TRAIN.load(sources[0].c_str(), 0, MNIST_MAX_VAL);
+    TEST.load(sources[1].c_str(), 1, MNIST_MAX_VAL);
+
+    search.run(TRAIN, TEST);                                                                        /// Trains the trials with successive halving
+    search.report(TEST.samples);                                                                    /// Prints the ranked results
+
+    return(0);
+}
+
+/**
+ * Implements the `score` mode of the driver. A saved model scores a file through a pipeline
+ * of a parser, the model's forward pass and a writer, each one on its own thread.
+ *
+ * @param[in] argc number of user arguments
+ * @param[in] argv vector of user arguments, i.e. `nn.out score <checkpoint> <input> <output> [options]`
+ *
+ * @return 0, if the scoring was completed normally
+ *
+ * @note    Only the `-t` and `-a` options apply to the scoring. Neither dataset is loaded.
+ */
+int score_main(int argc, char* argv[])
+{
+    std::vector<int> vec;
+    nn settings;                                                                                    /// Receives the model options, which the scorer ignores
+    scorer scoring;
+
+    if (argc < 5)
+    {
+        usage(argv[0]);
+    }
+    char* output = argv[4];
+    argv[4] = argv[0];                                                                              /// Parses the options that follow the files
+    parse_arguments(argc - 4, argv + 4, vec, settings);
+    host.detect();
+    host.bind();
+
+    scoring.open(argv[2], argv[3], output);
+    scoring.run();
+    scoring.report();
+
+    return(0);
+}
+
+/**
+ * Implements the `online` mode of the driver. The model learns from labelled samples as they
+ * arrive, and publishes its weights as a checkpoint every now and then.
+ *
+ * @param[in] argc number of user arguments
+ * @param[in] argv vector of user arguments, i.e. `nn.out online <source> [options]`
+ *
+ * @return 0, if the source ended or the learner was interrupted
+ *
+ * @note    The source is `-` for the standard input, or the filepath of a Unix socket to listen on.
+ *          The model is given by `-i`, `-h` and `-o`, or resumed from a checkpoint with `-r`.
+ *          Neither dataset is loaded.
+ */
+int online_main(int argc, char* argv[])
+{
+    std::vector<int> vec;
+    learner learning;
+
+    if (argc < 3)
+    {
+        usage(argv[0]);
+    }
+    char* source = argv[2];
+    argv[2] = argv[0];                                                                              /// Parses the options that follow the source
+    parse_arguments(argc - 2, argv + 2, vec, learning.model);
+    host.detect();
+    host.bind();
+
+    learning.open(source, vec);
+    learning.model.summary();
+    learning.run();
+    learning.report();
+
+    return(0);
+}
+
 /**
  * Implements the driver for the Neural Network.
  *
@@ -11,29 +120,65 @@
  *
  * @note    For the driver to work properly, adjust the project settings found at the `Common.h` file.
  *          One such adjustment is to define the filepaths of the training and the evaluation subsets.
- *          Another strongly recommended change is the number of threads requested by the OS. This number
- *          is recommended to be equal to the number of the hosts's Logical Processors. This will very
- *          possibly optimize execution time and therefore increase performance.
+ *          The number of threads is detected at runtime and is equal to the number of the host's Logical
+ *          Processors, unless overridden by the `-t` option. The threads are pinned to the Logical Processors
+ *          based on the `-a` affinity policy, before any of the model's or the datasets' memory is touched.
  */
 int main(int argc, char* argv[])
 {
     int cli_rows, cli_cols, cursor_row, cursor_col;
     double start, end;
     std::vector<int> vec;
+    std::string sources[2] = { TRAINING_DATA_FILEPATH, EVALUATION_DATA_FILEPATH };                  /// Filepaths of the training and the evaluation datasets
+
+    if (argc > 1 && strcmp(argv[1], "sweep") == 0)
+    {
+        return sweep_main(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "score") == 0)
+    {
+        return score_main(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "online") == 0)
+    {
+        return online_main(argc, argv);
+    }
 
     nn fcn;                                                                                         /// Declares the image of the neural network
     dataset TRAIN(MNIST_CLASSES, MNIST_TRAIN);                                                      /// Declares training data subset
     dataset TEST(MNIST_CLASSES, MNIST_TEST);                                                        /// Declares evaluation data subset
 
-    parse_arguments(argc, argv, vec);                                                               /// Parses user arguments
+    parse_arguments(argc, argv, vec, fcn, sources);                                                 /// Parses user arguments
+    host.detect();                                                                                  /// Detects the host's threads and NUMA nodes
+    host.bind();                                                                                    /// Pins the thread team based on the affinity policy
+    PROFILE_HARDWARE(host.threads);                                                                 /// Opens the hardware counters of the thread team, if profiling
     start = omp_get_wtime();                                                                        /// Initializes benchmark
 
-    TRAIN.read_csv(TRAINING_DATA_FILEPATH, 0, MNIST_MAX_VAL);                                       /// Initializes training data subset
-    TEST.read_csv(EVALUATION_DATA_FILEPATH, 1, MNIST_MAX_VAL);                                      /// Initializes evaluation data subset
+    TRAIN.load(sources[0].c_str(), 0, MNIST_MAX_VAL);                                               /// Initializes training data subset, from a CSV or an IDX file
+    TEST.load(sources[1].c_str(), 1, MNIST_MAX_VAL);                                                /// Initializes evaluation data subset, from a CSV or an IDX file
 
     fcn.compile(vec, -1.0, 1.0);                                                                    /// Initializes the neural network's image
+    if (!fcn.resume_filepath.empty())
+    {
+        fcn.resume(fcn.resume_filepath.c_str());                                                   /// Restores the weights of a checkpoint
+    }
     fcn.summary();                                                                                  /// Prints model structure
-    fcn.fit(TRAIN);                                                                                 /// Trains the model
+    fcn.numa_summary(TRAIN);                                                                        /// Prints model and data placement across NUMA nodes
+    fcn.fit(TRAIN, &TEST);                                                                          /// Trains the model, scoring it on the evaluation set in the background if requested
+    if (fcn.sparsity > 0.0)
+    {
+        fcn.pruning_report(TEST);                                                                   /// Prints the accuracy versus latency of pruning the model
+        fcn.prune(fcn.sparsity);                                                                    /// Prunes the model down to the requested sparsity
+    }
+    if (fcn.retained > 0.0 || fcn.max_rank > 0)
+    {
+        fcn.lowrank_report(TRAIN, TEST);                                                            /// Prints the accuracy versus cost of factorizing the model
+        fcn.factorize(fcn.retained > 0.0 ? fcn.retained : 1.0, fcn.max_rank);                      /// Factorizes every layer at the requested energy or rank
+        if (fcn.fine_tune > 0)
+        {
+            fcn.fine_tune_factored(TRAIN, fcn.fine_tune);                                           /// Recovers some of the accuracy lost to the factorization
+        }
+    }
     fcn.evaluate(TEST);                                                                             /// Evaluates the model
     fcn.export_weights("mnist-fcn");
 
@@ -17,6 +17,9 @@
  */
 int nn::accuracy(double* (&Y), int dim)
 {
+    PROFILE_SCOPE(PHASE_ACCURACY, 0);
+    TRACE_SCOPE("accuracy", "reduction", -1);
+
     double max_val = -2.0;
     int max_idx = 0;
 
@@ -0,0 +1,417 @@
+
+#include "libnn.h"
+#include "neural.hpp"
+
+#include <mutex>                                    /// std::call_once(), std::mutex
+#include <atomic>                                   /// std::atomic
+#include <thread>                                   /// std::this_thread::yield()
+#include <memory>                                   /// std::unique_ptr, std::shared_ptr
+
+constexpr uint64_t READER_IDLE = UINT64_MAX;        /// Declares the epoch of a workspace that is not reading the model
+
+typedef std::shared_ptr<std::atomic<uint64_t>> reader_epoch;
+
+/**
+ * Implements a version of a model: the weights of a checkpoint, or of a training, that are
+ * published to the readers at once.
+ */
+struct model_version
+{
+    nn model;
+    long steps;                                     /// Training steps the weights were taken at
+};
+
+/**
+ * Implements the handle of a model. The handle publishes the current version of the model,
+ * and the layer structure it was compiled with, which is also the structure of its checkpoints.
+ *
+ * The readers announce the epoch they read the model in through their workspaces, and load
+ * the current version, without a lock or a loop. A writer publishes a new version, moves to
+ * the next epoch, and waits for every reader that may still be reading the old version to
+ * announce a later epoch or none, before releasing it.
+ *
+ * The registry lock only guards the list of the readers' epochs. A writer copies the list under
+ * it, and waits on the copy without it, so registering a workspace never waits for a reload: a
+ * workspace registered after the copy can only read the new version. The copy shares the epochs
+ * with the workspaces, so a workspace may be released while a writer still waits on it.
+ */
+struct nn_model
+{
+    std::vector<int> structure;
+    int threads;
+    std::atomic<model_version*> current;
+    std::atomic<uint64_t> epoch;
+    mutable std::mutex writers;                     /// Serializes the writers
+    mutable std::mutex registry;                    /// Guards `readers`, for as long as it is modified or copied
+    mutable std::vector<reader_epoch> readers;      /// Epochs of the model's workspaces, which the writers wait on
+
+    nn_model(const std::vector<int>& structure, int threads, model_version* version) :
+        structure{ structure },
+        threads{ threads },
+        current{ version },
+        epoch{ 0 }
+    {
+
+    }
+
+    ~nn_model()
+    {
+        delete current.load();
+    }
+};
+
+/**
+ * Implements the workspace of a caller: the scratch buffer of `nn::forward_batch()`, and the
+ * epoch the caller reads the model in. Every thread of the model's team owns two rows of
+ * `width` activations.
+ */
+struct nn_workspace
+{
+    const nn_model* owner;
+    int width;
+    std::vector<double> rows;
+    reader_epoch epoch;                             /// Epoch of the model being read, or `READER_IDLE`, shared with the writers
+
+    nn_workspace() :
+        owner{ nullptr },
+        width{ 0 },
+        epoch{ std::make_shared<std::atomic<uint64_t>>(READER_IDLE) }
+    {
+
+    }
+};
+
+/**
+ * Marks a workspace as reading the current version of its model, for the lifetime of the section.
+ *
+ * @note    The epoch is announced before the version is loaded, both sequentially consistent, so a
+ *          writer that misses the announcement has published its version before the load.
+ */
+class read_section
+{
+public:
+    nn_workspace* workspace;
+    const model_version* version;
+
+    read_section(const nn_model* model, nn_workspace* workspace) :
+        workspace{ workspace }
+    {
+        workspace->epoch->store(model->epoch.load());
+        version = model->current.load();
+    }
+
+    ~read_section()
+    {
+        workspace->epoch->store(READER_IDLE, std::memory_order_release);
+    }
+};
+
+static thread_local std::string last_error;         /// Message of the last error on the calling thread
+static std::once_flag host_detected;
+
+/**
+ * Runs the body of a call, translating the exceptions of the project into status codes.
+ *
+ * @param[in] body the body of the call
+ *
+ * @return `NN_OK`, or the status of the exception thrown by the body
+ */
+template <typename F>
+static nn_status guarded(F body)
+{
+    try
+    {
+        std::call_once(host_detected, []() { host.detect(); });                         /// Detects the host without pinning the caller's threads
+        last_error.clear();
+        body();
+        return NN_OK;
+    }
+    catch (const std::bad_alloc&)
+    {
+        last_error = "out of memory";
+        return NN_ERROR_MEMORY;
+    }
+    catch (const std::invalid_argument& e)
+    {
+        last_error = e.what();
+        return NN_ERROR_ARGUMENT;
+    }
+    catch (const std::exception& e)
+    {
+        last_error = e.what();
+        return NN_ERROR_IO;
+    }
+}
+
+/**
+ * Compiles a fresh version of a model. The model never prints, so it is not tuned.
+ *
+ * @param[in] structure the layer structure of the model (biases included, but for the output layer)
+ * @param[in] threads the number of threads of the model's kernels (0 uses all the logical processors)
+ *
+ * @return the version, owned by the caller
+ */
+static model_version* new_version(const std::vector<int>& structure, int threads)
+{
+    std::unique_ptr<model_version> version(new model_version);
+
+    version->steps = 0;
+    version->model.threads = threads;
+    version->model.tune = false;
+    version->model.compile(structure, -1.0, 1.0);
+    return version.release();
+}
+
+/**
+ * Loads a version of a model from a checkpoint.
+ *
+ * @param[in] filepath the checkpoint
+ * @param[in] threads the number of threads of the model's kernels (0 uses all the logical processors)
+ *
+ * @return the version, owned by the caller
+ */
+static model_version* load_version(const char* filepath, int threads)
+{
+    std::unique_ptr<model_version> version(new model_version);
+
+    version->model.threads = threads;
+    version->model.tune = false;
+    version->steps = version->model.load(filepath);
+    return version.release();
+}
+
+/**
+ * Registers a new workspace with its model, so that the writers wait on its epoch.
+ */
+static nn_workspace* new_workspace(const nn_model* model)
+{
+    std::unique_ptr<nn_workspace> space(new nn_workspace);
+    const model_version* version = model->current.load();
+
+    space->owner = model;
+    space->width = version->model.hidden_width();                                      /// Every version has the same layers
+    space->rows.assign((size_t)version->model.threads * 2 * space->width, 0.0);        /// Faults the rows in now, rather than during the first inference
+    std::lock_guard<std::mutex> guard(model->registry);
+    model->readers.push_back(space->epoch);
+    return space.release();
+}
+
+/**
+ * Unregisters a workspace from its model, and releases it.
+ */
+static void delete_workspace(nn_workspace* workspace)
+{
+    {
+        std::lock_guard<std::mutex> guard(workspace->owner->registry);
+        auto& readers = workspace->owner->readers;
+        readers.erase(std::remove(readers.begin(), readers.end(), workspace->epoch), readers.end());
+    }
+    delete workspace;
+}
+
+/**
+ * Checks the arguments of an inference, and runs it on the current version of the model, in
+ * the caller's workspace, or in a temporary one.
+ *
+ * @note    With the caller's workspace, the inference never waits for a lock: a version swapped
+ *          in meanwhile is only released once the inference is done with the old one. A temporary
+ *          workspace only takes the registry lock, which a reload never holds while it waits.
+ */
+template <typename T>
+static nn_status infer(const nn_model* model, const T* inputs, size_t batch, T* outputs, nn_workspace* workspace)
+{
+    if (model == nullptr || (batch > 0 && (inputs == nullptr || outputs == nullptr)) || (workspace != nullptr && workspace->owner != model))
+    {
+        last_error = "infer: invalid model, buffers or workspace";
+        return NN_ERROR_ARGUMENT;
+    }
+    return guarded([&]() {
+        std::unique_ptr<nn_workspace, void (*)(nn_workspace*)> temporary(nullptr, delete_workspace);
+        if (workspace == nullptr)
+        {
+            temporary.reset(new_workspace(model));
+            workspace = temporary.get();
+        }
+        read_section section(model, workspace);
+        section.version->model.forward_batch(inputs, batch, outputs, workspace->rows.data());
+    });
+}
+
+extern "C" {
+
+int nn_version(void)
+{
+    return NN_API_VERSION;
+}
+
+const char* nn_last_error(void)
+{
+    return last_error.c_str();
+}
+
+nn_status nn_create(const int* sizes, int count, int threads, nn_model** model)
+{
+    if (sizes == nullptr || count < 3 || threads < 0 || model == nullptr || std::any_of(sizes, sizes + count, [](int size) { return size <= 0; }))
+    {
+        last_error = "create: a model needs an input, a hidden and an output layer, all of them non-empty";
+        return NN_ERROR_ARGUMENT;
+    }
+    return guarded([&]() {
+        std::vector<int> structure(sizes, sizes + count);
+        for (int layer = 0; layer < count - 1; layer += 1)
+        {
+            structure[layer] += 1;                                                      /// Adds the bias of every layer but the output one
+        }
+        std::unique_ptr<model_version> version(new_version(structure, threads));
+        *model = new nn_model(structure, threads, version.get());
+        version.release();
+    });
+}
+
+nn_status nn_load(const char* filepath, int threads, nn_model** model)
+{
+    if (filepath == nullptr || threads < 0 || model == nullptr)
+    {
+        last_error = "load: invalid filepath or model";
+        return NN_ERROR_ARGUMENT;
+    }
+    return guarded([&]() {
+        std::unique_ptr<model_version> version(load_version(filepath, threads));
+        *model = new nn_model(version->model.layers, threads, version.get());
+        version.release();
+    });
+}
+
+/**
+ * @note    The checkpoint is loaded into a new version of the model, on the calling thread, while
+ *          the readers keep reading the current one. The new version is then published, and the
+ *          old one is released once the last inference that reads it is done.
+ */
+nn_status nn_load_into(nn_model* model, const char* filepath)
+{
+    if (model == nullptr || filepath == nullptr)
+    {
+        last_error = "load: invalid filepath or model";
+        return NN_ERROR_ARGUMENT;
+    }
+    return guarded([&]() {
+        std::unique_ptr<model_version> version(load_version(filepath, model->threads));
+        if (version->model.layers != model->structure)
+        {
+            throw std::runtime_error(std::string("load: the layers of ") + filepath + " differ from the model's");
+        }
+
+        std::lock_guard<std::mutex> guard(model->writers);
+        std::unique_ptr<model_version> old(model->current.exchange(version.release()));
+        uint64_t retired = model->epoch.fetch_add(1);                                   /// Readers of an epoch up to `retired` may hold the old version
+        std::vector<reader_epoch> readers;
+        {
+            std::lock_guard<std::mutex> copy(model->registry);                          /// Later workspaces only see the new version
+            readers = model->readers;
+        }
+        for (const reader_epoch& reader : readers)
+        {
+            while (reader->load() <= retired)
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+}
+
+nn_status nn_save(const nn_model* model, const char* filepath)
+{
+    if (model == nullptr || filepath == nullptr)
+    {
+        last_error = "save: invalid filepath or model";
+        return NN_ERROR_ARGUMENT;
+    }
+    return guarded([&]() {
+        std::lock_guard<std::mutex> guard(model->writers);                              /// Keeps the version from being swapped out
+        const model_version* version = model->current.load();
+        write_checkpoint(filepath, model->structure, version->model.memory.base, version->model.parameter_bytes, version->steps);
+    });
+}
+
+void nn_destroy(nn_model* model)
+{
+    delete model;
+}
+
+int nn_input_size(const nn_model* model)
+{
+    return model == nullptr ? 0 : model->structure[0] - 1;
+}
+
+int nn_output_size(const nn_model* model)
+{
+    return model == nullptr ? 0 : model->structure.back();
+}
+
+nn_status nn_workspace_create(const nn_model* model, nn_workspace** workspace)
+{
+    if (model == nullptr || workspace == nullptr)
+    {
+        last_error = "workspace: invalid model or workspace";
+        return NN_ERROR_ARGUMENT;
+    }
+    return guarded([&]() {
+        *workspace = new_workspace(model);
+    });
+}
+
+void nn_workspace_destroy(nn_workspace* workspace)
+{
+    if (workspace != nullptr)
+    {
+        delete_workspace(workspace);
+    }
+}
+
+nn_status nn_infer_f64(const nn_model* model, const double* inputs, size_t batch, double* outputs, nn_workspace* workspace)
+{
+    return infer(model, inputs, batch, outputs, workspace);
+}
+
+nn_status nn_infer_f32(const nn_model* model, const float* inputs, size_t batch, float* outputs, nn_workspace* workspace)
+{
+    return infer(model, inputs, batch, outputs, workspace);
+}
+
+/**
+ * @note    Every sample is bound to the model in place, and its target is read in place. A step is the
+ *          same fused forward and backward pass as a training step of `fit()`. The current version is
+ *          trained in place, so the training must not overlap any other call on the model.
+ */
+nn_status nn_train_f64(nn_model* model, const double* inputs, const double* targets, size_t batch, double learning_rate, double* loss)
+{
+    if (model == nullptr || (batch > 0 && (inputs == nullptr || targets == nullptr)) || !(learning_rate > 0.0))
+    {
+        last_error = "train: invalid model, buffers or learning rate";
+        return NN_ERROR_ARGUMENT;
+    }
+    return guarded([&]() {
+        model_version* version = model->current.load();
+        nn& network = version->model;
+        int in = network.layers[0] - 1, out = network.layers.back();
+        double total = 0.0;
+
+        network.learning_rate = learning_rate;
+        for (size_t sample = 0; sample < batch; sample += 1)
+        {
+            double* X = const_cast<double*>(inputs + sample * in);                      /// The kernels never write to the input
+            double* Y = const_cast<double*>(targets + sample * out);
+            network.bind_input(X);
+            network.forward();
+            total += network.mse_loss(Y, out);
+            network.back_propagation_update(Y);
+        }
+        version->steps += batch;
+        if (loss != nullptr)
+        {
+            *loss = batch > 0 ? total / batch : 0.0;
+        }
+    });
+}
+
+}
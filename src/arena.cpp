@@ -0,0 +1,91 @@
+
+#include "arena.hpp"
+
+/**
+ * Makes the single allocation of the arena.
+ *
+ * @param[in] bytes the total size of the sub-buffers to be handed out
+ * @param[in] hugetlb if `true`, the arena is backed by explicitly reserved huge pages
+ *
+ * @note    The memory is not touched here. The pages are placed on a NUMA node by the
+ *          first thread that writes into them, just like with regular allocations. With
+ *          huge pages, the placement granularity becomes the size of a huge page.
+ */
+void arena::reserve(size_t bytes, bool hugetlb)
+{
+    release();
+    capacity = align(bytes);
+    used = 0;
+#ifdef __linux__
+    mapped = (capacity + ARENA_HUGE_PAGE - 1) & ~(ARENA_HUGE_PAGE - 1);               /// Huge pages have to be fully mapped
+
+    void* region = MAP_FAILED;
+    if (hugetlb)
+    {
+        region = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        huge = region != MAP_FAILED;
+    }
+    if (region == MAP_FAILED)
+    {
+        size_t padded = mapped + ARENA_HUGE_PAGE;                                     /// Over-maps to align the arena to a huge page boundary
+        char* raw = (char*)mmap(NULL, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == (char*)MAP_FAILED)
+        {
+            throw std::bad_alloc();
+        }
+
+        char* aligned = (char*)(((uintptr_t)raw + ARENA_HUGE_PAGE - 1) & ~(uintptr_t)(ARENA_HUGE_PAGE - 1));
+        if (aligned != raw)
+        {
+            munmap(raw, aligned - raw);                                                 /// Trims the unaligned head
+        }
+        munmap(aligned + mapped, (raw + padded) - (aligned + mapped));                  /// Trims the tail
+        region = aligned;
+#ifdef MADV_HUGEPAGE
+        huge = madvise(region, mapped, MADV_HUGEPAGE) == 0;                             /// Asks for transparent huge pages
+#endif
+    }
+    base = (char*)region;
+#else
+    mapped = capacity;
+    base = (char*)::operator new(capacity, std::align_val_t(ARENA_ALIGNMENT));
+#endif
+}
+
+/**
+ * Hands out a sub-buffer of the arena.
+ *
+ * @param[in] bytes the size of the sub-buffer
+ *
+ * @return a pointer to a sub-buffer aligned to `ARENA_ALIGNMENT`
+ */
+void* arena::allocate(size_t bytes)
+{
+    size_t offset = used;
+
+    used += align(bytes);
+    if (used > capacity)
+    {
+        throw std::runtime_error("arena: out of reserved memory");
+    }
+    return base + offset;
+}
+
+/**
+ * Releases the arena at once. Every sub-buffer handed out becomes invalid.
+ */
+void arena::release(void)
+{
+    if (base == nullptr)
+    {
+        return;
+    }
+#ifdef __linux__
+    munmap(base, mapped);
+#else
+    ::operator delete(base, std::align_val_t(ARENA_ALIGNMENT));
+#endif
+    base = nullptr;
+    capacity = used = mapped = 0;
+    huge = false;
+}
@@ -0,0 +1,275 @@
+
+#include "checkpoint.hpp"
+
+#include <zlib.h>                                   /// compress2(), uncompress()
+#include <fcntl.h>                                  /// open()
+#include <unistd.h>                                 /// write(), fsync()
+
+/**
+ * Prepares the checkpointer for a model and starts the background writer.
+ *
+ * @param[in] l the layer structure of the model
+ * @param[in] parameter_bytes the size of the model's weights
+ *
+ * @note    The writer is not pinned to the thread team's logical processors, so that
+ *          it does not compete with the master thread for a single processor. It is also
+ *          scheduled as a batch thread, so that waking it up never preempts the training.
+ */
+void checkpointer::open(const std::vector<int>& l, size_t parameter_bytes)
+{
+    close();
+    layers = l;
+    bytes = parameter_bytes;
+    memory.reserve(2 * arena::align(bytes), ARENA_HUGETLB);
+    buffers[0] = memory.allocate<char>(bytes);
+    buffers[1] = memory.allocate<char>(bytes);
+    std::memset(memory.base, 0, memory.used);                                          /// Faults the buffers in now, rather than during the first snapshots
+    writing = pending = -1;
+    steps = 0;
+    last = omp_get_wtime();
+    stopping = false;
+    active = every_steps > 0 || every_seconds > 0.0;
+    taken = written = dropped = 0;
+    stall = stall_max = write_time = 0.0;
+    written_bytes = 0;
+
+    writer = std::thread([this]() {
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (auto& cpu : host.cpus)
+        {
+            CPU_SET(cpu, &set);
+        }
+        sched_setaffinity(0, sizeof(set), &set);
+
+        sched_param batch = {};
+        sched_setscheduler(0, SCHED_BATCH, &batch);                                     /// Keeps the writer from preempting the training thread on wake-up
+#endif
+        drain();
+    });
+}
+
+/**
+ * Copies the model's weights into a snapshot buffer and queues it for the writer.
+ * This is the only part of a checkpoint that blocks the training thread.
+ *
+ * @param[in] parameters the model's weights (`bytes` long)
+ *
+ * @note    The copy goes to the buffer the writer is not reading. If that buffer still
+ *          holds a queued snapshot, the snapshot is dropped in favour of the newer one.
+ */
+void checkpointer::take(const void* parameters)
+{
+    double start = omp_get_wtime();
+    int slot;
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        slot = writing == 0 ? 1 : 0;
+        if (pending == slot)                                                            /// Withdraws the stale snapshot before overwriting it
+        {
+            pending = -1;
+            dropped += 1;
+        }
+    }
+    std::memcpy(buffers[slot], parameters, bytes);
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        pending = slot;
+        pending_step = steps;
+    }
+    wake.notify_one();
+
+    last = omp_get_wtime();
+    taken += 1;
+    stall += last - start;
+    stall_max = std::max(stall_max, last - start);
+}
+
+/**
+ * Compresses a snapshot and writes it as the checkpoint.
+ *
+ * @param[in] slot the snapshot buffer to write
+ * @param[in] step the training step the snapshot was taken at
+ */
+void checkpointer::write(int slot, long step)
+{
+    double start = omp_get_wtime();
+
+    written_bytes += write_checkpoint(filepath.c_str(), layers, buffers[slot], bytes, step);
+    written += 1;
+    write_time += omp_get_wtime() - start;
+}
+
+/**
+ * Implements the loop of the background writer. The writer sleeps until a snapshot is
+ * queued, and writes the queued snapshots until the checkpointer is closed.
+ */
+void checkpointer::drain(void)
+{
+    std::unique_lock<std::mutex> guard(lock);
+
+    while (true)
+    {
+        wake.wait(guard, [this]() { return pending >= 0 || stopping; });
+        if (pending < 0)                                                                /// Stops only once every queued snapshot is written
+        {
+            return;
+        }
+
+        long step = pending_step;
+        writing = pending;
+        pending = -1;
+        guard.unlock();
+        try
+        {
+            write(writing, step);
+        }
+        catch (const std::exception& e)                                                 /// A failed checkpoint must not bring the training down
+        {
+            std::cerr << "\n" << e.what() << "\n";
+        }
+        guard.lock();
+        writing = -1;
+    }
+}
+
+/**
+ * Writes the last queued snapshot, if any, and stops the background writer.
+ */
+void checkpointer::close(void)
+{
+    if (!writer.joinable())
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_one();
+    writer.join();
+    active = false;
+}
+
+/**
+ * Prints the checkpoints taken and the time they blocked the training thread for.
+ */
+void checkpointer::report(void)
+{
+    std::ios state(nullptr);
+
+    state.copyfmt(std::cout);
+    std::cout << "\n[CHECKPOINT] [TAKEN " << taken << "] [WRITTEN " << written << "] [DROPPED " << dropped << "] "
+              << std::fixed << std::setprecision(1) << "Training blocked for " << 1e6 * stall / std::max(taken, 1)
+              << " us per checkpoint (max " << 1e6 * stall_max << " us), writer took " << 1e3 * write_time / std::max(written, 1)
+              << " ms per checkpoint, " << written_bytes / std::max(written, 1) / 1024 << " KiB each, to " << filepath << "\n";
+    std::cout.copyfmt(state);
+}
+
+/**
+ * Reads a checkpoint into a model's weights.
+ *
+ * @param[in] filename the filepath of the checkpoint
+ * @param[in] l the layer structure of the model
+ * @param[in, out] parameters the model's weights
+ * @param[in] parameter_bytes the size of the model's weights
+ * @param[out] step the training step the checkpoint was taken at
+ *
+ * @note    The checkpoint has to be taken from a model with the same layer structure.
+ */
+void read_checkpoint(const char* filename, const std::vector<int>& l, void* parameters, size_t parameter_bytes, long& step)
+{
+    std::ifstream stream(filename, std::ios::binary);
+    checkpoint_header header;
+    std::vector<int> layers;
+    std::vector<Bytef> payload;
+    uLongf raw = parameter_bytes;
+
+    if (!stream.read((char*)&header, sizeof(header)) || header.magic != CHECKPOINT_MAGIC || header.version != CHECKPOINT_VERSION)
+    {
+        throw std::runtime_error(std::string("checkpoint: not a checkpoint: ") + filename);
+    }
+
+    layers.resize(header.n_layers);
+    payload.resize(header.compressed_bytes);
+    stream.read((char*)layers.data(), layers.size() * sizeof(int));
+    stream.read((char*)payload.data(), payload.size());
+    if (!stream || layers != l || header.raw_bytes != parameter_bytes)
+    {
+        throw std::runtime_error(std::string("checkpoint: layer structure mismatch: ") + filename);
+    }
+    if (uncompress((Bytef*)parameters, &raw, payload.data(), payload.size()) != Z_OK || raw != parameter_bytes)
+    {
+        throw std::runtime_error(std::string("checkpoint: corrupted: ") + filename);
+    }
+    step = header.step;
+}
+
+/**
+ * Compresses a model's weights and writes them as a checkpoint. The checkpoint is written to
+ * a temporary file, flushed to the disk, and renamed over the previous checkpoint.
+ *
+ * @param[in] filename the filepath of the checkpoint
+ * @param[in] l the layer structure of the model
+ * @param[in] parameters the model's weights
+ * @param[in] parameter_bytes the size of the model's weights
+ * @param[in] step the training step the weights were taken at
+ *
+ * @return the size of the checkpoint, in bytes
+ */
+size_t write_checkpoint(const char* filename, const std::vector<int>& l, const void* parameters, size_t parameter_bytes, long step)
+{
+    std::string temporary = std::string(filename) + ".tmp";
+    uLongf compressed = compressBound(parameter_bytes);
+    std::vector<Bytef> payload(compressed);
+    checkpoint_header header;
+
+    if (compress2(payload.data(), &compressed, (const Bytef*)parameters, parameter_bytes, Z_BEST_SPEED) != Z_OK)
+    {
+        throw std::runtime_error("checkpoint: compression failed");
+    }
+
+    header = { CHECKPOINT_MAGIC, CHECKPOINT_VERSION, (uint32_t)l.size(), Z_BEST_SPEED, (uint64_t)step, parameter_bytes, compressed };
+    int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        throw std::runtime_error("checkpoint: cannot open " + temporary);
+    }
+    bool complete = ::write(fd, &header, sizeof(header)) == sizeof(header)
+                 && ::write(fd, l.data(), l.size() * sizeof(int)) == (ssize_t)(l.size() * sizeof(int))
+                 && ::write(fd, payload.data(), compressed) == (ssize_t)compressed
+                 && fsync(fd) == 0;
+    ::close(fd);
+    if (!complete || rename(temporary.c_str(), filename) != 0)                          /// Replaces the previous checkpoint atomically
+    {
+        throw std::runtime_error(std::string("checkpoint: cannot write ") + filename);
+    }
+    return sizeof(header) + l.size() * sizeof(int) + compressed;
+}
+
+/**
+ * Reads the layer structure of the model a checkpoint was taken from.
+ *
+ * @param[in] filename the filepath of the checkpoint
+ *
+ * @return the layer structure, to compile a model the checkpoint can be read into
+ */
+std::vector<int> checkpoint_layers(const char* filename)
+{
+    std::ifstream stream(filename, std::ios::binary);
+    checkpoint_header header;
+    std::vector<int> layers;
+
+    if (!stream.read((char*)&header, sizeof(header)) || header.magic != CHECKPOINT_MAGIC || header.version != CHECKPOINT_VERSION)
+    {
+        throw std::runtime_error(std::string("checkpoint: not a checkpoint: ") + filename);
+    }
+    layers.resize(header.n_layers);
+    if (header.n_layers < 2 || !stream.read((char*)layers.data(), layers.size() * sizeof(int)))
+    {
+        throw std::runtime_error(std::string("checkpoint: corrupted: ") + filename);
+    }
+    return layers;
+}
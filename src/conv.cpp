@@ -0,0 +1,388 @@
+
+#include "neural.hpp"
+
+/**
+ * Infers the shape of the layer's output from the shape of its input.
+ *
+ * @param[in] c the channels of the input
+ * @param[in] h the height of the input
+ * @param[in] w the width of the input
+ */
+void feature_layer::shape(int c, int h, int w)
+{
+    if (size < 1 || (kind == LAYER_CONV2D && out_c < 1))
+    {
+        throw std::runtime_error("conv: a feature layer needs a window, and a convolution its filters, of at least 1 (one)");
+    }
+    in_c = c;
+    in_h = h;
+    in_w = w;
+    if (kind == LAYER_CONV2D)
+    {
+        out_h = h - size + 1;
+        out_w = w - size + 1;
+    }
+    else
+    {
+        out_c = c;
+        out_h = h / size;
+        out_w = w / size;
+    }
+    if (out_h < 1 || out_w < 1)
+    {
+        throw std::runtime_error("conv: the input of a feature layer is too small");
+    }
+}
+
+/**
+ * Computes the number of synapses of the layer, biases included.
+ *
+ * @return the number of synapses
+ */
+size_t feature_layer::parameters(void)
+{
+    return kind == LAYER_CONV2D ? (size_t)out_c * (reduction() + 1) : 0;
+}
+
+/**
+ * Computes the size of the layer's buffers, apart from its synapses.
+ *
+ * @return the number of bytes the layer needs from the model's arena
+ */
+size_t feature_layer::footprint(void)
+{
+    size_t bytes = arena::align((size_t)CONV_BATCH * outputs() * sizeof(double)) + arena::align(outputs() * sizeof(double));
+
+    if (kind == LAYER_CONV2D)
+    {
+        bytes += arena::align((size_t)reduction() * CONV_BATCH * out_pixels() * sizeof(double));
+        bytes += arena::align((size_t)reduction() * out_pixels() * sizeof(double));
+    }
+    else
+    {
+        bytes += arena::align((size_t)CONV_BATCH * outputs() * sizeof(int));
+    }
+    return bytes;
+}
+
+/**
+ * Feeds a batch of samples forward through the layer.
+ *
+ * @param[in] planes the input planes, one per channel and sample (`planes[c * batch + b]`)
+ * @param[in] batch the number of samples (at most `CONV_BATCH`)
+ * @param[in] threads the number of threads to use
+ *
+ * @note    A convolution first lowers its input: row `r` of `columns` holds, for every
+ *          output pixel of every sample, the input value synapse `r` of a filter is applied to.
+ *          The output is then the product of the filters with `columns`, computed in tiles of
+ *          `CONV_TILE` output pixels that stay in registers through the whole reduction.
+ */
+void feature_layer::forward(const double* const* planes, int batch, int threads)
+{
+    int P = batch * out_pixels();
+
+    if (kind == LAYER_MAXPOOL)
+    {
+#pragma omp parallel for num_threads(threads) schedule(static)
+        for (int plane = 0; plane < out_c * batch; plane += 1)
+        {
+            const double* in = planes[plane];
+            for (int y = 0; y < out_h; y += 1)
+            {
+                for (int x = 0; x < out_w; x += 1)
+                {
+                    int best = (y * size) * in_w + x * size;
+                    for (int dy = 0; dy < size; dy += 1)
+                    {
+                        for (int dx = 0; dx < size; dx += 1)
+                        {
+                            int position = (y * size + dy) * in_w + x * size + dx;
+                            best = in[position] > in[best] ? position : best;
+                        }
+                    }
+                    out[plane * out_pixels() + y * out_w + x] = in[best];
+                    argmax[plane * out_pixels() + y * out_w + x] = plane * in_pixels() + best;
+                }
+            }
+        }
+        return;
+    }
+
+#pragma omp parallel for num_threads(threads) schedule(static)
+    for (int r = 0; r < reduction(); r += 1)                                                    /// Lowers the input (im2col)
+    {
+        int c = r / (size * size), dy = (r / size) % size, dx = r % size;
+        for (int b = 0; b < batch; b += 1)
+        {
+            const double* in = planes[c * batch + b];
+            double* row = columns + (size_t)r * P + b * out_pixels();
+            for (int y = 0; y < out_h; y += 1)
+            {
+                std::copy_n(in + (y + dy) * in_w + dx, out_w, row + y * out_w);
+            }
+        }
+    }
+
+    int tiles = (P + CONV_TILE - 1) / CONV_TILE;
+#pragma omp parallel for collapse(2) num_threads(threads) schedule(static)
+    for (int f = 0; f < out_c; f += 1)                                                          /// Multiplies the filters with the lowered input
+    {
+        for (int tile = 0; tile < tiles; tile += 1)
+        {
+            const double* w = weights + (size_t)f * (reduction() + 1);
+            int begin = tile * CONV_TILE, width = std::min(CONV_TILE, P - begin);
+            double acc[CONV_TILE];
+
+            std::fill_n(acc, CONV_TILE, w[reduction()]);                                        /// Starts from the bias
+            for (int r = 0; r < reduction(); r += 1)
+            {
+                const double* row = columns + (size_t)r * P + begin;
+#pragma omp simd
+                for (int p = 0; p < width; p += 1)
+                {
+                    acc[p] += w[r] * row[p];
+                }
+            }
+            for (int p = 0; p < width; p += 1)
+            {
+                out[(size_t)f * P + begin + p] = relu(acc[p]);
+            }
+        }
+    }
+}
+
+/**
+ * Propagates the error of a single sample back through the layer, and updates its synapses.
+ *
+ * @param[in, out] d_in the error of the layer's input, or `nullptr` if not needed (the first layer)
+ * @param[in] learning_rate the learning rate of the update
+ * @param[in] threads the number of threads to use
+ *
+ * @note    The error of the layer's output (`err`) has to be computed beforehand. The lowered
+ *          input of the last forward is reused, so the sample has to be the last one fed forward.
+ */
+void feature_layer::backward(double* d_in, double learning_rate, int threads)
+{
+    int P = out_pixels();
+
+    if (kind == LAYER_MAXPOOL)
+    {
+        if (d_in != nullptr)
+        {
+            std::fill_n(d_in, in_c * in_pixels(), 0.0);
+            for (int o = 0; o < outputs(); o += 1)                                              /// Routes the error to the maximum of every window
+            {
+                d_in[argmax[o]] += err[o];
+            }
+        }
+        return;
+    }
+
+#pragma omp parallel for num_threads(threads) schedule(static)
+    for (int o = 0; o < outputs(); o += 1)                                                      /// Filters the error by the derivative of the ReLU (of its output)
+    {
+        err[o] = out[o] > 0.0 ? err[o] : 0.0;
+    }
+
+    if (d_in != nullptr)
+    {
+#pragma omp parallel for num_threads(threads) schedule(static)
+        for (int r = 0; r < reduction(); r += 1)                                                /// Propagates the error to the lowered input
+        {
+            double* row = d_columns + (size_t)r * P;
+            std::fill_n(row, P, 0.0);
+            for (int f = 0; f < out_c; f += 1)
+            {
+                double w = weights[(size_t)f * (reduction() + 1) + r];
+#pragma omp simd
+                for (int p = 0; p < P; p += 1)
+                {
+                    row[p] += w * err[(size_t)f * P + p];
+                }
+            }
+        }
+
+#pragma omp parallel for num_threads(threads) schedule(static)
+        for (int c = 0; c < in_c; c += 1)                                                       /// Folds the lowered error back onto the input (col2im)
+        {
+            double* plane = d_in + (size_t)c * in_pixels();
+            std::fill_n(plane, in_pixels(), 0.0);
+            for (int k = 0; k < size * size; k += 1)
+            {
+                int dy = k / size, dx = k % size;
+                const double* row = d_columns + (size_t)(c * size * size + k) * P;
+                for (int y = 0; y < out_h; y += 1)
+                {
+                    for (int x = 0; x < out_w; x += 1)
+                    {
+                        plane[(y + dy) * in_w + x + dx] += row[y * out_w + x];
+                    }
+                }
+            }
+        }
+    }
+
+#pragma omp parallel for num_threads(threads) schedule(static)
+    for (int f = 0; f < out_c; f += 1)                                                          /// Updates the filters
+    {
+        double* w = weights + (size_t)f * (reduction() + 1);
+        const double* e = err + (size_t)f * P;
+        double bias = 0.0;
+
+        for (int r = 0; r < reduction(); r += 1)
+        {
+            const double* row = columns + (size_t)r * P;
+            double REGISTER = 0.0;
+#pragma omp simd reduction(+ : REGISTER)
+            for (int p = 0; p < P; p += 1)
+            {
+                REGISTER += e[p] * row[p];
+            }
+            w[r] -= learning_rate * REGISTER;
+        }
+#pragma omp simd reduction(+ : bias)
+        for (int p = 0; p < P; p += 1)
+        {
+            bias += e[p];
+        }
+        w[reduction()] -= learning_rate * bias;
+    }
+}
+
+/**
+ * Infers the shapes of the feature layers, starting from the shape of a sample.
+ *
+ * @return the number of values of the last feature layer's output, i.e. the inputs of the first fully connected layer
+ */
+int nn::set_features(void)
+{
+    int c = MNIST_CHANNELS, h = MNIST_HEIGHT, w = MNIST_WIDTH;
+
+    for (auto& layer : features)
+    {
+        layer.shape(c, h, w);
+        c = layer.out_c;
+        h = layer.out_h;
+        w = layer.out_w;
+    }
+    return c * h * w;
+}
+
+/**
+ * Allocates the buffers of the feature layers, and the rows that gather their output.
+ *
+ * @note    The synapses of the feature layers are handed out by `set_weights()`, since they are part of
+ *          the model's parameter region.
+ */
+void nn::set_feature_buffers(void)
+{
+    for (auto& layer : features)
+    {
+        layer.out = memory.allocate<double>((size_t)CONV_BATCH * layer.outputs());
+        layer.err = memory.allocate<double>(layer.outputs());
+        if (layer.kind == LAYER_CONV2D)
+        {
+            layer.columns = memory.allocate<double>((size_t)layer.reduction() * CONV_BATCH * layer.out_pixels());
+            layer.d_columns = memory.allocate<double>((size_t)layer.reduction() * layer.out_pixels());
+        }
+        else
+        {
+            layer.argmax = memory.allocate<int>((size_t)CONV_BATCH * layer.outputs());
+        }
+    }
+    flat = memory.allocate<double*>(CONV_BATCH);
+    for (int b = 0; b < CONV_BATCH; b += 1)
+    {
+        flat[b] = memory.allocate<double>(layers[0] - 1);
+    }
+}
+
+/**
+ * Feeds a batch of input rows forward through the feature layers. The output of the last
+ * feature layer is gathered into `flat`, one row per sample, to be bound to the fully
+ * connected layers.
+ *
+ * @param[in] X the input rows of the samples
+ * @param[in] count the number of samples (at most `CONV_BATCH`)
+ */
+void nn::extract(double* const* X, int count)
+{
+    std::vector<const double*> planes((size_t)MNIST_CHANNELS * count);
+
+    TRACE_SCOPE("extract", "kernel", -1);
+    for (int c = 0; c < MNIST_CHANNELS; c += 1)
+    {
+        for (int b = 0; b < count; b += 1)
+        {
+            planes[c * count + b] = X[b] + c * MNIST_HEIGHT * MNIST_WIDTH;
+        }
+    }
+    for (auto& layer : features)
+    {
+        layer.forward(planes.data(), count, threads);
+        planes.resize((size_t)layer.out_c * count);
+        for (int plane = 0; plane < layer.out_c * count; plane += 1)                           /// The output of a layer is the input of the next
+        {
+            planes[plane] = layer.out + (size_t)plane * layer.out_pixels();
+        }
+    }
+
+    feature_layer& last = features.back();
+    for (int b = 0; b < count; b += 1)                                                          /// Gathers the channels of every sample
+    {
+        for (int c = 0; c < last.out_c; c += 1)
+        {
+            std::copy_n(last.out + ((size_t)c * count + b) * last.out_pixels(), last.out_pixels(), flat[b] + c * last.out_pixels());
+        }
+    }
+}
+
+/**
+ * Binds a sample to the fully connected layers. Without feature layers, the sample is bound
+ * straight from the dataset; otherwise, it is first fed through the feature layers.
+ *
+ * @param[in, out] data the dataset that holds the sample
+ * @param[in] sample the index of the sample
+ * @param[in] streaming `true` if the samples are bound in order, so that the feature layers
+ *            can process a whole batch of `CONV_BATCH` samples at once (inference only)
+ *
+ * @note    A sample bound for training has to be bound with `streaming` unset, since
+ *          `backward_features()` reuses the lowered input of that single sample.
+ */
+void nn::bind_sample(dataset(&data), int sample, bool streaming)
+{
+    if (features.empty())
+    {
+        bind_input(data, sample);
+        return;
+    }
+    if (!streaming)
+    {
+        extract(data.X + sample, 1);
+        bind_input(flat[0]);
+        return;
+    }
+    if (sample % CONV_BATCH == 0)
+    {
+        extract(data.X + sample, std::min(CONV_BATCH, data.samples - sample));
+    }
+    bind_input(flat[sample % CONV_BATCH]);
+}
+
+/**
+ * Propagates the error of the bound sample back through the feature layers, and updates
+ * their synapses. Must be called after `back_propagation_update()`, which computes the error
+ * of the output of the last feature layer with the synapses of the first fully connected
+ * layer, before their update.
+ *
+ * @note    The sample must have been bound with `bind_sample()`, since every layer reuses the
+ *          lowered input (or the maxima) of its last forward.
+ */
+void nn::backward_features(void)
+{
+    TRACE_SCOPE("backward_features", "kernel", -1);
+    for (int i = features.size() - 1; i >= 0; i -= 1)
+    {
+        features[i].backward(i == 0 ? nullptr : features[i - 1].err, learning_rate, threads);
+    }
+}
@@ -103,6 +103,8 @@ ssize_t dataset::getline(char** lineptr, size_t* n, FILE* stream)
 
 void dataset::read_csv(const char* filename, int dataset_flag, double x_max)
 {
+    TRACE_SCOPE("read_csv", "loader", -1);
+
     FILE* stream;
     stream = fopen(filename, "r");
 
@@ -189,6 +191,191 @@ void dataset::read_csv(const char* filename, int dataset_flag, double x_max)
         fclose(stream);
 
         samples = rows - 1;
+        place();                                                                                                /// Distributes the parsed samples across the host's NUMA nodes
+    }
+}
+
+/**
+ * Reads a dataset from a pair of IDX files: the images, and the labels that come with them.
+ *
+ * @param[in] filename the filepath of the images (e.g. `train-images-idx3-ubyte`, or its `.gz`)
+ * @param[in] dataset_flag  if `0`, then the function reads training data
+ *                          if `1`, then the function reads evaluation data
+ * @param[in] x_max this is used to normalize the dataset in range [0, 1]
+ *
+ * @note    The filepath of the labels is derived from the one of the images, following the naming
+ *          of the MNIST distribution. Both files are mapped into memory (see `idx_file`), so there is
+ *          nothing to parse: every pixel is converted straight from the mapping.
+ *
+ * @note    Like `place()`, the samples are interleaved across the threads, which allocate and first
+ *          touch them, and count their non-zero inputs, in the same pass that converts them. At most `samples`
+ *          samples are read.
+ */
+void dataset::read_idx(const char* filename, int dataset_flag, double x_max)
+{
+    TRACE_SCOPE("read_idx", "loader", -1);
+
+    idx_file images, labels;
+    long long non_zero = 0;
+
+    images.open(filename);
+    labels.open(idx_labels_filepath(filename).c_str());
+    if (images.word(0) != IDX_IMAGES_MAGIC || labels.word(0) != IDX_LABELS_MAGIC)
+    {
+        throw std::runtime_error(std::string("idx: not a pair of images and labels: ") + filename);
+    }
+
+    const unsigned char* pixels = images.bytes + 16;                                                            /// Skips the signature and the 3 (three) dimensions
+    const unsigned char* label = labels.bytes + 8;
+    samples = std::min({ samples, (int)images.word(1), (int)labels.word(1) });
+    dimensions = images.word(2) * images.word(3);
+    if (16 + (size_t)samples * dimensions > images.size || 8 + (size_t)samples > labels.size)
+    {
+        throw std::runtime_error(std::string("idx: truncated: ") + filename);
+    }
+
+    std::cout << "\n";
+    progress_bar progress{ dataset_flag == 0 ? "Loading training dataset" : "Loading evaluation dataset", '*', CLI_WINDOW_WIDTH };
+
+    X = new double* [samples];
+    Y = new double* [samples];
+    double level[256];                                                                                          /// Normalized value of every byte, the same as the CSV's
+    for (int v = 0; v < 256; v += 1)
+    {
+        level[v] = (v + 0.0) / x_max;
+    }
+#pragma omp parallel num_threads(host.threads) reduction(+ : non_zero)
+    {
+        TRACE_SCOPE("place", "loader", -1);
+#pragma omp for schedule(static, 1) nowait
+        for (int i = 0; i < samples; i += 1)
+        {
+            const unsigned char* row = pixels + (size_t)i * dimensions;
+            double* shard = new double[dimensions];                                                             /// Allocated by the thread that owns the sample
+            for (int j = 0; j < dimensions; j += 1)
+            {
+                shard[j] = level[row[j]];
+                non_zero += (row[j] != 0);
+            }
+            X[i] = shard;
+            Y[i] = new double[classes];
+            for (int y_idx = 0; y_idx < classes; y_idx += 1)
+            {
+                Y[i][y_idx] = y_idx == label[i] ? 1.0 : 0.0;
+            }
+        }
+    }
+    density = samples > 0 ? (double)non_zero / ((double)samples * dimensions) : 1.0;
+    progress.indicate_progress(1.0);
+}
+
+/**
+ * Reads a dataset from a file, whatever its format.
+ *
+ * @param[in] filename the filepath of a CSV file, or of the images of an IDX pair (raw or compressed with gzip)
+ * @param[in] dataset_flag  if `0`, then the function reads training data
+ *                          if `1`, then the function reads evaluation data
+ * @param[in] x_max this is used to normalize the dataset in range [0, 1]
+ *
+ * @note The format is told from the first bytes of the file, not from its extension.
+ */
+void dataset::load(const char* filename, int dataset_flag, double x_max)
+{
+    if (!std::ifstream(filename))
+    {
+        throw std::runtime_error(std::string("dataset: cannot open ") + filename);
+    }
+    if (is_idx(filename))
+    {
+        read_idx(filename, dataset_flag, x_max);
+        return;
+    }
+    read_csv(filename, dataset_flag, x_max);
+}
+
+/**
+ * Interleaves the samples across the host's NUMA nodes. The samples are dealt to the
+ * threads one by one, and every thread allocates and first touches the inputs and the
+ * expected output of its samples. That way, the dataset is spread across the nodes
+ * proportionally to the threads running on each node, instead of residing on the node
+ * of the thread that parsed the file.
+ *
+ * @note    The placement is for bandwidth, not locality: the kernels split the neurons of a
+ *          layer across the threads, so every thread reads the whole input row of every sample.
+ *          A sample is thus mostly remote to all the threads but those of its node, while the
+ *          samples drawn in turn are read from the memory of every node, rather than of one.
+ *
+ * @note    While every sample passes through the cache, its non-zero inputs are counted
+ *          to measure the `density` of the dataset.
+ */
+void dataset::place(void)
+{
+    long long non_zero = 0;
+
+#pragma omp parallel num_threads(host.threads) reduction(+ : non_zero)
+    {
+        TRACE_SCOPE("place", "loader", -1);
+#pragma omp for schedule(static, 1) nowait
+        for (int i = 0; i < samples; i += 1)
+        {
+            double* shard = new double[dimensions];                                                             /// Allocated by the thread that owns the sample
+            double* expected = new double[classes];
+            std::memcpy(shard, X[i], dimensions * sizeof(double));                                              /// First touch happens on the owner's node
+            std::memcpy(expected, Y[i], classes * sizeof(double));
+            delete[] X[i];
+            delete[] Y[i];
+            X[i] = shard;
+            Y[i] = expected;
+            for (int j = 0; j < dimensions; j += 1)
+            {
+                non_zero += (shard[j] != 0.0);
+            }
+        }
+    }
+    density = samples > 0 ? (double)non_zero / ((double)samples * dimensions) : 1.0;
+}
+
+/**
+ * Encodes the input samples as a Compressed Sparse Row matrix. Only the non-zero
+ * inputs of every sample are kept, along with their positions in the sample.
+ *
+ * @note    The dense samples in `X` are kept too, since the sparse encoding is
+ *          only used by the kernels of the model's first layer.
+ */
+void dataset::encode_sparse(void)
+{
+    if (offsets != nullptr)                                                                                     /// The samples have already been encoded
+    {
+        return;
+    }
+
+    offsets = new int[samples + 1];
+    offsets[0] = 0;
+    for (int i = 0; i < samples; i += 1)                                                                        /// Counts the non-zero inputs of every sample
+    {
+        int count = 0;
+        for (int j = 0; j < dimensions; j += 1)
+        {
+            count += (X[i][j] != 0.0);
+        }
+        offsets[i + 1] = offsets[i] + count;
+    }
+
+    indices = new int[offsets[samples]];
+    values = new double[offsets[samples]];
+#pragma omp parallel for num_threads(host.threads) schedule(static)
+    for (int i = 0; i < samples; i += 1)                                                                        /// Fills every sample's shard of the encoding
+    {
+        int k = offsets[i];
+        for (int j = 0; j < dimensions; j += 1)
+        {
+            if (X[i][j] != 0.0)
+            {
+                indices[k] = j;
+                values[k] = X[i][j];
+                k += 1;
+            }
+        }
     }
 }
 
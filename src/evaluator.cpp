@@ -0,0 +1,191 @@
+
+#include "evaluator.hpp"
+#include "neural.hpp"
+#include "interface.hpp"
+
+/**
+ * Builds the replicas of a model and starts the worker threads.
+ *
+ * @param[in] model the model to be evaluated during its training
+ * @param[in, out] HELD_OUT the dataset the snapshots are scored on
+ *
+ * @note    The replicas are compiled with the layers (and the feature layers) of the model,
+ *          so a snapshot of the model's parameter region is restored into a replica with a
+ *          single `memcpy()`. The kernels of the first layer are selected for `HELD_OUT` once,
+ *          here, since the selection may encode the dataset as sparse.
+ */
+void evaluator::open(nn& model, dataset(&HELD_OUT))
+{
+    std::vector<int> l = model.layers;
+
+    close();
+    if (workers <= 0)
+    {
+        return;
+    }
+    if (!model.features.empty())
+    {
+        l[0] = MNIST_CHANNELS * MNIST_HEIGHT * MNIST_WIDTH + 1;                         /// Compiles the replica from the shape of a sample
+    }
+    data = &HELD_OUT;
+    bytes = model.parameter_bytes;
+    for (int worker = 0; worker < workers; worker += 1)
+    {
+        nn* replica = new nn;
+        replica->threads = 1;
+        replica->tune = false;
+        replica->features = model.features;
+        replica->compile(l, 0.0, 0.0);
+        if (replica->parameter_bytes != bytes)
+        {
+            delete replica;
+            throw std::runtime_error("evaluator: the replica does not match the model");
+        }
+        if (worker == 0)
+        {
+            replica->select_input_kernel(HELD_OUT);
+        }
+        replica->sparse_input = replicas.empty() ? replica->sparse_input : replicas[0]->sparse_input;
+        replicas.push_back(replica);
+    }
+
+    std::vector<int> spare;                                                             /// Logical processors left idle by the thread team
+    auto team = host.thread_cpu.begin(), team_end = team + std::min((int)host.thread_cpu.size(), model.threads);
+    for (auto& cpu : host.cpus)
+    {
+        if (std::find(team, team_end, cpu) == team_end)
+        {
+            spare.push_back(cpu);
+        }
+    }
+    if (spare.empty())
+    {
+        spare = host.cpus;
+    }
+
+    stopping = false;
+    active = true;
+    results.clear();
+    for (int worker = 0; worker < workers; worker += 1)
+    {
+        pool.emplace_back([this, worker, spare]() {
+#ifdef __linux__
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (auto& cpu : spare)
+            {
+                CPU_SET(cpu, &set);
+            }
+            sched_setaffinity(0, sizeof(set), &set);
+#endif
+            work(worker);
+        });
+    }
+}
+
+/**
+ * Copies the model's weights into a snapshot and queues it for the workers.
+ * This is the only part of an evaluation that blocks the training thread.
+ *
+ * @param[in] parameters the model's weights (`bytes` long)
+ * @param[in] epoch the number of the epoch that just ended
+ */
+void evaluator::submit(const void* parameters, int epoch)
+{
+    evaluation_job job;
+
+    job.epoch = epoch;
+    job.weights.assign((const char*)parameters, (const char*)parameters + bytes);
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        jobs.push_back(std::move(job));
+    }
+    wake.notify_one();
+}
+
+/**
+ * Scores the queued snapshots on the held-out dataset, until the evaluator is closed
+ * and the queue is empty.
+ *
+ * @param[in] worker the index of the worker, and of its replica
+ */
+void evaluator::work(int worker)
+{
+    nn& replica = *replicas[worker];
+
+    while (true)
+    {
+        evaluation_job job;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait(guard, [this]() { return stopping || !jobs.empty(); });
+            if (jobs.empty())
+            {
+                return;
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        evaluation_result result;
+        result.epoch = job.epoch;
+        replica.restore(job.weights.data());
+        result.seconds = replica.infer(*data, KERNELS_DENSE, result.loss, result.validity);
+
+        std::lock_guard<std::mutex> guard(lock);
+        results.push_back(result);
+        print_epoch_stats(result.epoch, result.loss, result.validity, result.seconds, true);
+    }
+}
+
+/**
+ * Waits for the workers to score every queued snapshot, then stops them and releases the replicas.
+ */
+void evaluator::close(void)
+{
+    if (!pool.empty())
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& thread : pool)
+        {
+            thread.join();
+        }
+        pool.clear();
+    }
+    for (auto& replica : replicas)
+    {
+        delete replica;
+    }
+    replicas.clear();
+    active = false;
+}
+
+/**
+ * Prints the epoch with the best held-out accuracy, along with the time the workers spent scoring.
+ */
+void evaluator::report(void)
+{
+    std::ios state(nullptr);
+    double seconds = 0.0;
+    int best = 0;
+
+    if (results.empty())
+    {
+        return;
+    }
+    for (int i = 0; i < results.size(); i += 1)
+    {
+        seconds += results[i].seconds;
+        best = results[i].validity > results[best].validity ? i : best;
+    }
+
+    state.copyfmt(std::cout);
+    std::cout << "\n\n[HELD-OUT] [SNAPSHOTS " << results.size() << "] [BEST EPOCH " << results[best].epoch << "] [LOSS " << std::fixed
+              << std::setprecision(5) << results[best].loss << "] [ACCURACY " << results[best].validity << " out of " << data->samples << "] "
+              << std::setprecision(3) << "Scored in the background for " << seconds << " seconds by " << workers << " worker(s)\n";
+    std::cout.copyfmt(state);
+}
@@ -0,0 +1,242 @@
+
+#include "neural.hpp"
+
+/**
+ * Factorizes the weights of every layer into two thin matrices, with a truncated singular
+ * value decomposition.
+ *
+ * @param[in] kept the fraction of the spectral energy of every layer to keep, which gives its rank
+ * @param[in] cap the highest rank of a layer (0 does not cap it)
+ *
+ * @note    A layer whose rank would not save any multiply-add is left dense. The synapses of the
+ *          bias are never factorized.
+ *
+ * @note    The dense weights of the factorized layers are replaced by the product of their factors,
+ *          so the dense and the factorized kernels compute the same outputs. Training after the
+ *          factorization regrows the full rank, until `refactorize()` is called.
+ */
+void nn::factorize(double kept, int cap)
+{
+    if (factored == nullptr)
+    {
+        factored = new low_rank[layers.size() - 1];
+    }
+
+    for (int layer = 0; layer < layers.size() - 1; layer += 1)
+    {
+        int rows = layer == layers.size() - 2 ? layers[layer + 1] : layers[layer + 1] - 1;       /// The output layer has no bias
+        low_rank& matrix = factored[layer];
+
+        matrix.factorize(weights[layer], rows, layers[layer] - 1, threads);
+        matrix.rank = matrix.rank_for(kept);
+        if (cap > 0)
+        {
+            matrix.rank = std::min(matrix.rank, cap);
+        }
+        if (matrix.pays_off())
+        {
+            matrix.reconstruct(weights[layer]);
+        }
+    }
+}
+
+/**
+ * Factorizes the weights of every factorized layer again, at the same rank. Used after training
+ * the product of the factors, which regrows the full rank.
+ */
+void nn::refactorize(void)
+{
+    for (int layer = 0; layer < layers.size() - 1; layer += 1)
+    {
+        low_rank& matrix = factored[layer];
+        int rank = matrix.rank;
+
+        if (!matrix.pays_off())
+        {
+            continue;
+        }
+        matrix.factorize(weights[layer], matrix.rows, matrix.columns, threads);
+        matrix.rank = rank;
+        matrix.reconstruct(weights[layer]);
+    }
+}
+
+/**
+ * Trains the factorized model briefly, to recover some of the accuracy lost to the factorization.
+ * The product of the factors is trained like a dense model, by the epochs of `fit()`, and is then
+ * factorized again at the same ranks.
+ *
+ * @param[in, out] TRAIN the training dataset
+ * @param[in] epochs the number of epochs
+ *
+ * @note    Nothing is printed. Although passed by reference, `TRAIN` is not altered, other than
+ *          being encoded as sparse if its inputs are sparse enough.
+ */
+void nn::fine_tune_factored(dataset(&TRAIN), int epochs)
+{
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    double loss;
+    int validity;
+
+    select_input_kernel(TRAIN);
+    for (int epoch = 0; epoch < epochs; epoch += 1)
+    {
+        train_epoch(TRAIN, gen, loss, validity);
+    }
+    refactorize();
+}
+
+/**
+ * Feeds forward the bound input through the factorized model.
+ *
+ * @note    A factorized layer projects its input onto the `rank` components first, and then
+ *          expands the projection to its neurons: `rank * (rows + columns)` multiply-adds
+ *          instead of `rows * columns`. The layers left dense, and the synapses of the bias,
+ *          are read from the dense weights. Use after `factorize()`, for inference only.
+ */
+void nn::forward_factored(void)
+{
+    for (int layer = 1; layer < layers.size(); layer += 1)
+    {
+        int rows = layer == layers.size() - 1 ? layers[layer] : layers[layer] - 1;
+        int columns = layers[layer - 1] - 1;
+        low_rank& matrix = factored[layer - 1];
+        bool dense = !matrix.pays_off();
+        double* projected = matrix.projected;
+
+        PROFILE_SCOPE(PHASE_FORWARD, layer);
+        if (!dense)
+        {
+            int team = plan(layer - 1, matrix.rank, columns);
+#pragma omp parallel num_threads(team) if(team > 1)
+            {
+                TRACE_SCOPE("forward_factored", "projection", layer);
+#pragma omp for schedule(runtime) nowait
+                for (int component = 0; component < matrix.rank; component += 1)   /// Projects the input onto the components
+                {
+                    const double* r = matrix.right + (size_t)component * columns;
+                    double REGISTER = 0.0;
+#pragma omp simd reduction(+ : REGISTER)
+                    for (int synapse = 0; synapse < columns; synapse += 1)
+                    {
+                        REGISTER += r[synapse] * a[layer - 1][synapse];
+                    }
+                    projected[component] = REGISTER;
+                }
+            }
+        }
+
+        int team = plan(layer - 1, rows, dense ? columns : matrix.rank);
+        PROFILE_STRATEGY(PHASE_FORWARD, layer, strategy(layer - 1, team));
+#pragma omp parallel num_threads(team) if(team > 1)
+        {
+            TRACE_SCOPE("forward_factored", "kernel", layer);
+#pragma omp for schedule(runtime) nowait
+            for (int neuron = 0; neuron < rows; neuron += 1)
+            {
+                double* w = weights[layer - 1][neuron];
+                double REGISTER = w[columns];                                           /// Starts from the synapse of the previous layer's bias
+                if (dense)
+                {
+#pragma omp simd reduction(+ : REGISTER)
+                    for (int synapse = 0; synapse < columns; synapse += 1)
+                    {
+                        REGISTER += w[synapse] * a[layer - 1][synapse];
+                    }
+                }
+                else
+                {
+                    const double* l = matrix.left + (size_t)neuron * matrix.components;
+#pragma omp simd reduction(+ : REGISTER)
+                    for (int component = 0; component < matrix.rank; component += 1)  /// Expands the projection to the neuron
+                    {
+                        REGISTER += l[component] * projected[component];
+                    }
+                }
+                a[layer][neuron] = sigmoid(REGISTER);
+            }
+        }
+    }
+}
+
+/**
+ * Reports the accuracy versus cost trade-off of factorizing the trained model. For every
+ * fraction of the spectral energy in `LOWRANK_ENERGIES`, the model is factorized, and the
+ * ranks of the layers, the multiply-adds and the parameters per sample, the accuracy and the
+ * per-sample latency of the factorized kernels are printed, next to the dense model's. If
+ * fine-tuning is requested, the accuracy after `fine_tune` epochs is printed as well.
+ *
+ * @param[in, out] TRAIN the training dataset, for the fine-tuning
+ * @param[in, out] TEST the evaluation dataset
+ *
+ * @note    The trained weights are restored afterwards, and the factors are released.
+ *          Although passed by reference, neither dataset is altered, other than being
+ *          encoded as sparse if its inputs are sparse enough.
+ */
+void nn::lowrank_report(dataset(&TRAIN), dataset(&TEST))
+{
+    char* trained = new char[parameter_bytes];
+    double loss, dense, elapsed;
+    int validity;
+    size_t dense_flops = 0;
+
+    snapshot(trained);
+    for (int layer = 0; layer < layers.size() - 1; layer += 1)
+    {
+        int rows = layer == layers.size() - 2 ? layers[layer + 1] : layers[layer + 1] - 1;
+        dense_flops += (size_t)rows * layers[layer];
+    }
+    select_input_kernel(TEST);
+    dense = infer(TEST, KERNELS_DENSE, loss, validity);
+
+    std::cout << "\n\nLow-rank trade-off on " << TEST.samples << " samples";
+    if (fine_tune > 0)
+    {
+        std::cout << " (fine-tuned for " << fine_tune << " epoch(s))";
+    }
+    std::cout << "\n" << std::setw(10) << "Energy" << std::setw(16) << "Ranks" << std::setw(12) << "MFLOPs" << std::setw(12) << "Params K"
+              << std::setw(12) << "Accuracy" << std::setw(12) << "Loss" << std::setw(12) << "Latency us" << std::setw(10) << "Speedup";
+    if (fine_tune > 0)
+    {
+        std::cout << std::setw(12) << "Tuned";
+    }
+    std::cout << "\n" << std::fixed << std::setprecision(2)
+              << std::setw(10) << "dense" << std::setw(16) << "-" << std::setw(12) << 2e-6 * dense_flops << std::setw(12) << dense_flops / 1000.0
+              << std::setw(11) << 100.0 * validity / TEST.samples << "%" << std::setw(12) << std::setprecision(5) << loss << std::setprecision(2)
+              << std::setw(12) << 1e6 * dense / TEST.samples << std::setw(9) << 1.0 << "x\n";
+
+    for (double level : LOWRANK_ENERGIES)
+    {
+        std::string ranks;
+        size_t flops = 0;
+
+        restore(trained);
+        select_input_kernel(TEST);
+        factorize(level, 0);
+        for (int layer = 0; layer < layers.size() - 1; layer += 1)                      /// Counts the synapses of the factors, or of the dense layer, and the bias
+        {
+            low_rank& matrix = factored[layer];
+            ranks += (layer > 0 ? "/" : "") + (matrix.pays_off() ? std::to_string(matrix.rank) : std::string("-"));
+            flops += matrix.pays_off() ? (size_t)matrix.rank * (matrix.rows + matrix.columns) + matrix.rows : (size_t)matrix.rows * (matrix.columns + 1);
+        }
+        elapsed = infer(TEST, KERNELS_FACTORED, loss, validity);
+
+        std::cout << std::setw(9) << level * 100.0 << "%" << std::setw(16) << ranks << std::setw(12) << 2e-6 * flops << std::setw(12) << flops / 1000.0
+                  << std::setw(11) << 100.0 * validity / TEST.samples << "%" << std::setw(12) << std::setprecision(5) << loss << std::setprecision(2)
+                  << std::setw(12) << 1e6 * elapsed / TEST.samples << std::setw(9) << dense / elapsed << "x";
+        if (fine_tune > 0)
+        {
+            fine_tune_factored(TRAIN, fine_tune);
+            select_input_kernel(TEST);
+            infer(TEST, KERNELS_FACTORED, loss, validity);
+            std::cout << std::setw(11) << 100.0 * validity / TEST.samples << "%";
+        }
+        std::cout << "\n";
+    }
+
+    restore(trained);
+    delete[] trained;
+    delete[] factored;
+    factored = nullptr;
+}
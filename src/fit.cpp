@@ -2,46 +2,157 @@
 #include "neural.hpp"
 #include "interface.hpp"
 
+/**
+ * Trains the given model for a single epoch. The epoch draws as many random samples
+ * as there are in the dataset.
+ *
+ * @param[in, out] TRAIN the training dataset
+ * @param[in, out] gen the random generator that draws the samples
+ * @param[out] loss the average loss of the model over the epoch
+ * @param[out] validity the number of samples correctly classified during the epoch
+ *
+ * @return the time elapsed, in seconds
+ *
+ * @note    Although passed by reference, `TRAIN` is not altered. The kernels of the first layer
+ *          have to be selected for `TRAIN` beforehand, with `select_input_kernel()`.
+ *
+ * @note    If the activations of the frozen layers have been cached, with `cache_frozen()`, the
+ *          cached row of every sample is bound at the freeze boundary, and only the layers above
+ *          it are fed forward.
+ *
+ * @note    If the selective sampler is active, the loss of every forward pass decides whether the
+ *          sample's backward pass is kept. A kept pass steps by the learning rate times its weight.
+ */
+double nn::train_epoch(dataset(&TRAIN), std::mt19937& gen, double& loss, int& validity)
+{
+    int shuffled_idx;                                                                       /// Decalres sample "pointer"
+    int boundary = cache.layer;                                                             /// Layer whose activations are cached, if any
+    double* activations = a[boundary];                                                      /// Keeps the boundary's own activations, to be restored after the epoch
+    double sample_loss, weight, rate = learning_rate;
+    double start = omp_get_wtime();                                                         /// Benchmarks epoch
+    std::uniform_int_distribution<> dist(0, TRAIN.samples - 1);                             /// Distribute results between 0 and sample count exclusive
+
+    TRACE_SCOPE("epoch", "training", -1);
+    loss = 0.0;                                                                             /// Initializes epoch's training loss
+    validity = 0;                                                                           /// Initializes epoch's training accuracy
+    for (int sample = 0; sample < TRAIN.samples; sample += 1)                               /// Iterates through all examples of the training dataset
+    {
+        TRACE_SCOPE("train_step", "training", -1);
+        shuffled_idx = dist(gen);                                                           /// Selects a random example to avoid un-shuffled dataset event
+        if (boundary > 0)
+        {
+            a[boundary] = cache.row(shuffled_idx);                                          /// Binds the cached activations of the frozen layers
+            forward_from(boundary + 1);                                                     /// Feeds forward the trainable layers only
+        }
+        else
+        {
+            bind_sample(TRAIN, shuffled_idx, false);                                        /// Binds the selected input to the neural network
+            forward();                                                                      /// Feeds forward the selected input
+        }
+        sample_loss = mse_loss(TRAIN.Y[shuffled_idx], TRAIN.classes);                       /// Computes the loss of the forward pass, which the backward pass leaves unchanged
+        loss += sample_loss;                                                                /// Updates epoch's loss of the model
+        validity += accuracy(TRAIN.Y[shuffled_idx], TRAIN.classes);                         /// Updates epoch's accuracy of the model
+        weight = selective.active() ? selective.weigh(sample_loss, gen) : 1.0;              /// Skips the backward pass of an easy sample, now and then
+        if (weight > 0.0)
+        {
+            learning_rate = rate * weight;                                                  /// Scales the step of a kept pass, so the expected step is unchanged
+            back_propagation_update(TRAIN.Y[shuffled_idx]);                                 /// Computes the error for every neuron in the network and optimizes the weights, in one sweep
+            if (!features.empty() && !frozen[0])
+            {
+                backward_features();                                                        /// Trains the feature layers
+            }
+            learning_rate = rate;
+        }
+        checkpoints.tick(memory.base);                                                      /// Snapshots the weights, if a checkpoint is due
+    }
+    if (selective.active())
+    {
+        selective.end_epoch();
+    }
+    a[boundary] = activations;
+    loss /= (TRAIN.samples + 0.0);                                                          /// Averages epoch's loss of the model
+    return omp_get_wtime() - start;                                                         /// Terminates epoch's benchmark
+}
+
 /**
  * Trains the given model. The model is a simple multi-
  * layer feed forward perceptron.
  *
  * @param[in, out] TRAIN the training dataset
+ * @param[in, out] HELD_OUT the dataset the model is scored on at the end of every epoch, if the
+ *                 evaluator has been given workers (`nullptr` disables the scoring)
  *
- * @note Although passed by reference, `TRAIN` is not altered.
+ * @note    Although passed by reference, `TRAIN` is not altered, other than being encoded as sparse
+ *          if its inputs are sparse enough for the sparse kernels of the first layer to pay off.
+ *
+ * @note    The held-out scores are computed in the background, on snapshots of the weights, while the
+ *          next epochs are being trained. The training is only blocked for the copy of the weights.
+ *
+ * @note    If checkpoints are requested, they are written in the background during the training.
+ *          The training is only blocked for the copy of the weights, which is reported at the end.
+ *
+ * @note    If more than one stage is requested, the model is trained through a layer-wise pipeline.
+ *          The pipeline uses the dense kernels, and takes no checkpoints, since its stages update
+ *          their weights independently of each other.
+ *
+ * @note    If the first layers are frozen, their activations are computed once per sample before the
+ *          first epoch, and the epochs train the layers above them on the cached activations.
+ *
+ * @note    If the selective sampler is given a floor, the backward passes of the samples that are
+ *          already fitted are skipped at random, and the saved passes are reported at the end.
  */
-void nn::fit(dataset(&TRAIN))
+void nn::fit(dataset(&TRAIN), dataset* HELD_OUT)
 {
-    int shuffled_idx;                                                                       /// Decalres sample "pointer"
-    double start, end;                                                                      /// Declares epoch benchmark checkpoints
-    std::array<double, EPOCHS> loss;                                                        /// Declares container for training loss
-    std::array<int, EPOCHS> validity;                                                       /// Declares container for training accuracy
+    std::vector<double> loss(epochs);                                                       /// Declares container for training loss
+    std::vector<int> validity(epochs);                                                      /// Declares container for training accuracy
 
     std::random_device rd;                                                                  /// Initializes non-deterministic random generator
     std::mt19937 gen(rd());                                                                 /// Seeds mersenne twister
-    std::uniform_int_distribution<> dist(0, TRAIN.samples - 1);                             /// Distribute results between 0 and sample count exclusive
-                                                                                            /// Change this depending on the amount of loaded datasets
-    for (int epoch = 0; epoch < EPOCHS; epoch += 1)                                         /// Trains model
+
+    pipeline pipe;
+
+    if (stages > 1)
+    {
+        pipe.build(*this, stages);                                                          /// Splits the model into the stages of the pipeline
+    }
+    select_input_kernel(TRAIN);                                                             /// Selects the dense or the sparse kernels of the first layer
+    print_input_stats(TRAIN.density, sparse_input);
+    PROFILE_RESET();                                                                        /// Leaves the probes of the kernel selection and the tuning out of the breakdown
+    cache_frozen(TRAIN);                                                                    /// Feeds every sample through the frozen layers once, if the first ones are frozen
+    if (stages == 1 && (checkpoints.every_steps > 0 || checkpoints.every_seconds > 0.0))
+    {
+        checkpoints.open(layers, parameter_bytes);                                          /// Starts the background writer of the checkpoints
+    }
+    if (HELD_OUT != nullptr)
     {
-        loss[epoch] = 0.0;                                                                  /// Initializes epoch's training loss
-        validity[epoch] = 0;                                                                /// Initializes epoch's training accuracy
+        held_out.open(*this, *HELD_OUT);                                                    /// Starts the background evaluator, if it has workers
+    }
 
-        start = omp_get_wtime();                                                            /// Benchmarks epoch
-        for (int sample = 0; sample < TRAIN.samples; sample += 1)                           /// Iterates through all examples of the training dataset
+    for (int epoch = 0; epoch < epochs; epoch += 1)                                         /// Trains model
+    {
+        double elapsed = stages > 1 ? pipe.train_epoch(*this, TRAIN, gen, loss[epoch], validity[epoch]) : train_epoch(TRAIN, gen, loss[epoch], validity[epoch]);
+        print_epoch_stats(epoch + 1, loss[epoch], validity[epoch], elapsed);                /// Prints epoch's loss, accuracy and benchmark
+        if (held_out.active)
         {
-            shuffled_idx = dist(gen);                                                       /// Selects a random example to avoid un-shuffled dataset event
-            zero_grad(TRAIN.X[shuffled_idx]);                                               /// Resets the neurons of the neural network
-            forward();                                                                      /// Feeds forward the selected input
-            back_propagation(TRAIN.Y[shuffled_idx]);                                        /// Computes the error for every neuron in the network
-            optimize();                                                                     /// Optimizes weights using pack propagation
-            loss[epoch] += mse_loss(TRAIN.Y[shuffled_idx], TRAIN.classes);                  /// Updates epoch's loss of the model
-            validity[epoch] += accuracy(TRAIN.Y[shuffled_idx], TRAIN.classes);              /// Updates epoch's accuracy of the model
+            held_out.submit(memory.base, epoch + 1);                                        /// Hands a snapshot of the weights over to the evaluator
         }
-        end = omp_get_wtime();                                                              /// Terminates epoch's benchmark
-
-        loss[epoch] /= (TRAIN.samples + 0.0);                                               /// Averages epoch's loss of the model
-        print_epoch_stats(epoch + 1, loss[epoch], validity[epoch], end - start);            /// Prints epoch's loss, accuracy and benchmark
     }
+    if (held_out.active)
+    {
+        held_out.close();                                                                   /// Waits for the scores of the last epochs
+        held_out.report();
+    }
+    if (checkpoints.active)
+    {
+        checkpoints.close();                                                                /// Writes the last checkpoint and stops the writer
+        checkpoints.report();
+    }
+    cache.release();                                                                        /// Drops the activations of the frozen layers
+    if (selective.active())
+    {
+        selective.report();                                                                 /// Prints the backward passes saved by the sampler
+    }
+    PROFILE_REPORT("Training");                                                             /// Prints the per-phase breakdown of the training
 }
 
 /**
@@ -49,7 +160,8 @@ void nn::fit(dataset(&TRAIN))
  *
  * @param[in, out] TEST the evaluation dataset
  *
- * @note Although passed by reference, `TEST` is not altered.
+ * @note    Although passed by reference, `TEST` is not altered, other than being encoded as sparse
+ *          if its inputs are sparse enough for the sparse kernels of the first layer to pay off.
  */
 
 void nn::evaluate(dataset(&TEST))
@@ -57,11 +169,17 @@ void nn::evaluate(dataset(&TEST))
     int validity = 0;
     double start, end, loss = 0.0;
 
+    TRACE_SCOPE("evaluate", "evaluation", -1);
+    select_input_kernel(TEST);
+    PROFILE_RESET();                                                                        /// Leaves the probes of the kernel selection, and any report since the training, out of the breakdown
+
     start = omp_get_wtime();                                                                /// Benchmarks model's evaluation
     for (int sample = 0; sample < TEST.samples; sample += 1)                                /// Iterates through all examples of the evaluation dataset
     {
-        zero_grad(TEST.X[sample]);                                                          /// Resets the neurons of the neural network
-        forward();                                                                          /// Feeds forward the evaluation sample
+        TRACE_SCOPE("eval_step", "evaluation", -1);
+        bind_sample(TEST, sample, true);                                                    /// Binds the evaluation sample to the neural network
+        factored != nullptr ? forward_factored() : pruned != nullptr ? forward_pruned() : forward();
+                                                                                            /// Feeds forward the evaluation sample, through the factors if factorized, or the pruned weights if pruned
         loss += mse_loss(TEST.Y[sample], TEST.classes);                                     /// Updates loss of the model based on the evaluation set
         validity += accuracy(TEST.Y[sample], TEST.classes);                                 /// Updates accuracy of the model based on the evaluation set
     }
@@ -69,4 +187,5 @@ void nn::evaluate(dataset(&TEST))
 
     loss /= (TEST.samples + 0.0);
     print_epoch_stats(-1, loss, validity, end - start);                                     /// Prints evaluation loss, accuracy, and benchmark
+    PROFILE_REPORT("Evaluation");                                                           /// Prints the per-phase breakdown of the evaluation
 }
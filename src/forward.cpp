@@ -4,50 +4,179 @@
 /**
  * Feeds forward the given model a given input vector.
  *
- * @note    To exploit the full capabilities of the OpenMP framework, we use `collapse()` routine wherever possible.
- *          To use this routine, the given vector must be contiguous, therefore a 2D dynamic array cannot be collapsed.
- *          That's why there are temporary variables called `REGISTERS`, which are the 1D temporary image of those 2D
- *          vectors. Those registers are used during the parallel computations, and then we utilize the `memmove()`
- *          routine which has O(1) time complexity and transfers the computations back to the 2D vectors.
+ * @note    The input vector is never copied into the model. The input layer's `a[0]` points
+ *          straight to the row bound by `bind_input()`. For the same reason, the bias of each
+ *          layer is not stored with the layer's values; the last synapse of every neuron is the
+ *          synapse of the bias and seeds the neuron's sum.
+ *
+ * @note    The weighted sum of a neuron is kept in a register and filtered by the activation
+ *          function right away, since only the filtered value is needed by the back propagation.
+ *
+ * @note    Every parallel region shares its loop with `nowait`, so that the trace scope of a thread
+ *          closes as soon as the thread finishes its chunk. The wait for the slowest thread happens
+ *          at the end of the region and shows up as a gap in the thread's timeline. The threads and
+ *          the schedule of every invocation are planned by `plan()`, after its work and the matrix's
+ *          `tuning`: a small layer runs inline, on the calling thread.
+ *
+ * @note    If the input has been bound sparse, the first layer gathers only the synapses of
+ *          the non-zero inputs. The remaining layers are always dense.
  */
 void nn::forward(void)
 {
-    for (int layer = 1; layer < layers.size() - 1; layer += 1)
+    forward_from(1);
+}
+
+/**
+ * Feeds forward the activations of a layer through the layers above it.
+ *
+ * @param[in] first the first layer to compute, whose input `a[first - 1]` has been bound or computed
+ *
+ * @note    Used to skip the frozen layers, whose activations are cached, during a fine-tuning.
+ */
+void nn::forward_from(int first)
+{
+    for (int layer = first; layer < layers.size() - 1; layer += 1)
     {
-#pragma omp parallel for num_threads(N_THREADS)
-        for (int neuron = 0; neuron < layers[layer] - 1; neuron += 1)                                           /// Iterates through the hidden layer's neurons
+        PROFILE_SCOPE(PHASE_FORWARD, layer);
+        int team = plan(layer - 1, layers[layer] - 1, layer == 1 && input_nnz >= 0 ? input_nnz : layers[layer - 1] - 1);
+        PROFILE_STRATEGY(PHASE_FORWARD, layer, strategy(layer - 1, team));
+#pragma omp parallel num_threads(team) if(team > 1)
         {
-            double REGISTER = 0.0;
-#pragma omp simd reduction(+ : REGISTER)
-            for (int synapse = 0; synapse < layers[layer - 1]; synapse += 1)                                    /// Iterates throught the previous layer
+            TRACE_SCOPE("forward", "kernel", layer);
+#pragma omp for schedule(runtime) nowait
+            for (int neuron = 0; neuron < layers[layer] - 1; neuron += 1)                                           /// Iterates through the hidden layer's neurons
             {
-                REGISTER += weights[layer - 1][neuron][synapse] * a[layer - 1][synapse];                        /// Implements forward propagation for all hidden layers
+                double REGISTER = weights[layer - 1][neuron][layers[layer - 1] - 1];                                /// Starts from the synapse of the previous layer's bias
+                if (layer == 1 && input_nnz >= 0)
+                {
+#pragma omp simd reduction(+ : REGISTER)
+                    for (int k = 0; k < input_nnz; k += 1)                                                          /// Iterates through the non-zero inputs only
+                    {
+                        REGISTER += weights[0][neuron][input_index[k]] * input_value[k];
+                    }
+                    a[layer][neuron] = sigmoid(REGISTER);
+                    continue;
+                }
+#pragma omp simd reduction(+ : REGISTER)
+                for (int synapse = 0; synapse < layers[layer - 1] - 1; synapse += 1)                                /// Iterates throught the previous layer
+                {
+                    REGISTER += weights[layer - 1][neuron][synapse] * a[layer - 1][synapse];                        /// Implements forward propagation for all hidden layers
+                }
+                a[layer][neuron] = sigmoid(REGISTER);                                                               /// Applies model's activation function to computed results
             }
-            z[layer][neuron] = REGISTER;
         }
+    }
 
-#pragma omp parallel for num_threads(N_THREADS)
-        for (int neuron = 0; neuron < layers[layer] - 1; neuron += 1)
+    {
+        PROFILE_SCOPE(PHASE_FORWARD, layers.size() - 1);
+        int team = plan(layers.size() - 2, layers[layers.size() - 1], layers[layers.size() - 2] - 1);
+        PROFILE_STRATEGY(PHASE_FORWARD, layers.size() - 1, strategy(layers.size() - 2, team));
+#pragma omp parallel num_threads(team) if(team > 1)
         {
-            a[layer][neuron] = sigmoid(z[layer][neuron]);                                                       /// Applies model's activation function to computed results
+            TRACE_SCOPE("forward", "kernel", layers.size() - 1);
+#pragma omp for schedule(runtime) nowait
+            for (int neuron = 0; neuron < layers[layers.size() - 1]; neuron += 1)
+            {
+                double REGISTER = weights[layers.size() - 2][neuron][layers[layers.size() - 2] - 1];
+#pragma omp simd reduction(+ : REGISTER)
+                for (int synapse = 0; synapse < layers[layers.size() - 2] - 1; synapse += 1)
+                {
+                    REGISTER += weights[layers.size() - 2][neuron][synapse] * a[layers.size() - 2][synapse];        /// Implements forward propagation for the output layer
+                }
+                a[layers.size() - 1][neuron] = sigmoid(REGISTER);                                                   /// Applies model's activation function to computed results
+            }
         }
     }
+}
 
-#pragma omp parallel for num_threads(N_THREADS)
-    for (int neuron = 0; neuron < layers[layers.size() - 1]; neuron += 1)
+/**
+ * Computes the number of activations of the widest hidden layer, i.e. the length of a row of
+ * the scratch buffer of `forward_batch()`.
+ *
+ * @return the number of doubles of a row
+ */
+int nn::hidden_width(void) const
+{
+    int width = 1;
+
+    for (int layer = 1; layer < layers.size() - 1; layer += 1)
     {
-        double REGISTER = 0.0;
-#pragma omp simd reduction(+ : REGISTER)
-        for (int synapse = 0; synapse < layers[layers.size() - 2]; synapse += 1)
-        {
-            REGISTER += weights[layers.size() - 2][neuron][synapse] * a[layers.size() - 2][synapse];            /// Implements forward propagation for the output layer
-        }
-        z[layers.size() - 1][neuron] = REGISTER;
+        width = std::max(width, layers[layer] - 1);
     }
+    return width;
+}
+
+/**
+ * Feeds a batch of samples forward, reading the inputs and writing the outputs in place.
+ *
+ * @param[in] X `batch` contiguous rows of inputs
+ * @param[in] batch the number of samples
+ * @param[out] Y `batch` contiguous rows of outputs
+ * @param[in, out] scratch 2 (two) rows of `hidden_width()` doubles for every thread of the model
+ *
+ * @note    Unlike `forward()`, the kernel never writes to the model: every thread of the team
+ *          takes whole samples, and keeps their activations in its own rows of the scratch buffer.
+ *          Hence any number of callers can share the model, each one with its own scratch buffer.
+ *          The inputs are converted to `double` as they are read, so a `float` batch is never
+ *          copied either. A batch too small to pay for waking the threads up runs inline.
+ */
+template <typename T>
+void nn::forward_batch(const T* X, size_t batch, T* Y, double* scratch) const
+{
+    int matrices = layers.size() - 1, inputs = layers[0] - 1, outputs = layers[matrices];
+    int width = hidden_width();
+    double cost = 0.0;
 
-#pragma omp parallel for num_threads(N_THREADS)
-    for (int neuron = 0; neuron < layers[layers.size() - 1]; neuron += 1)
+    for (int m = 0; m < matrices; m += 1)
     {
-        a[layers.size() - 1][neuron] = sigmoid(z[layers.size() - 1][neuron]);                                   /// Applies model's activation function to computed results
-    }                                                                                                           /// Deallocates the temporary container off the memory
+        cost += (double)layers[m] * layers[m + 1];
+    }
+    int team = (int)std::max(1.0, std::min({ (double)threads, (double)batch, batch * cost / PARALLEL_MIN_WORK }));
+#pragma omp parallel for num_threads(team) if(team > 1) schedule(static)
+    for (long sample = 0; sample < (long)batch; sample += 1)
+    {
+        double* buffer = scratch + (size_t)omp_get_thread_num() * 2 * width;
+        const T* x = X + (size_t)sample * inputs;
+        T* y = Y + (size_t)sample * outputs;
+        const double* in = nullptr;
+        double* out = buffer;
+
+        for (int m = 0; m < matrices; m += 1)
+        {
+            int columns = layers[m] - 1;
+            int rows = m == matrices - 1 ? outputs : layers[m + 1] - 1;
+            for (int neuron = 0; neuron < rows; neuron += 1)
+            {
+                const double* w = weights[m][neuron];
+                double REGISTER = w[columns];                                                   /// Starts from the synapse of the previous layer's bias
+                if (m == 0)
+                {
+#pragma omp simd reduction(+ : REGISTER)
+                    for (int synapse = 0; synapse < columns; synapse += 1)
+                    {
+                        REGISTER += w[synapse] * (double)x[synapse];
+                    }
+                }
+                else
+                {
+#pragma omp simd reduction(+ : REGISTER)
+                    for (int synapse = 0; synapse < columns; synapse += 1)
+                    {
+                        REGISTER += w[synapse] * in[synapse];
+                    }
+                }
+                if (m == matrices - 1)
+                {
+                    y[neuron] = (T)sigmoid(REGISTER);
+                    continue;
+                }
+                out[neuron] = sigmoid(REGISTER);
+            }
+            in = out;
+            out = out == buffer ? buffer + width : buffer;                                      /// Alternates between the two rows of the thread
+        }
+    }
 }
+
+template void nn::forward_batch<double>(const double* X, size_t batch, double* Y, double* scratch) const;
+template void nn::forward_batch<float>(const float* X, size_t batch, float* Y, double* scratch) const;
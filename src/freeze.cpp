@@ -0,0 +1,93 @@
+
+#include "neural.hpp"
+
+/**
+ * Reserves the rows of the cache.
+ *
+ * @param[in] layer the layer whose activations are cached
+ * @param[in] samples the number of rows, one per training sample
+ * @param[in] width the number of activations of a row
+ * @param[in] pitch the number of doubles between two consecutive rows, at least `width`
+ *
+ * @note    The pages are not touched here, so they are placed by the thread that fills the rows.
+ */
+void activation_cache::reserve(int layer, int samples, int width, int pitch)
+{
+    release();
+    this->samples = samples;
+    this->width = width;
+    this->pitch = pitch;
+    memory.reserve(bytes(), ARENA_HUGETLB);
+    rows = memory.allocate<double>((size_t)samples * pitch);
+    this->layer = layer;
+}
+
+/**
+ * Releases the rows of the cache. Every row bound to a model becomes invalid.
+ */
+void activation_cache::release(void)
+{
+    memory.release();
+    rows = nullptr;
+    layer = samples = width = pitch = 0;
+}
+
+/**
+ * Finds the lowest weight matrix updated by the training.
+ *
+ * @return the index of the first weight matrix that is not frozen, or the number of weight
+ *         matrices if every one of them is frozen
+ */
+int nn::lowest_trainable(void) const
+{
+    int matrix = 0;
+
+    while (matrix < layers.size() - 1 && frozen[matrix])
+    {
+        matrix += 1;
+    }
+    return matrix;
+}
+
+/**
+ * Caches the activations of every training sample at the freeze boundary: the layer fed by
+ * the last of the frozen weight matrices at the bottom of the model. Their weights never change,
+ * so every sample is fed through them once, and `train_epoch()` then binds the cached row of a
+ * sample in place of the boundary's activations, and feeds forward from the layer above.
+ *
+ * @param[in, out] TRAIN the training dataset
+ *
+ * @note    Nothing is cached unless the first weight matrix is frozen. Frozen matrices above a
+ *          trainable one are only skipped by the updates, since their inputs keep changing.
+ *
+ * @note    The cache is released by `fit()`, since any other change to the frozen weights
+ *          (e.g. a factorization) makes it stale.
+ *
+ * @note    Although passed by reference, `TRAIN` is not altered, other than being encoded as sparse
+ *          if its inputs are sparse enough.
+ */
+void nn::cache_frozen(dataset(&TRAIN))
+{
+    int boundary = lowest_trainable();
+    int width = layers[boundary] - 1;
+    double start = omp_get_wtime();
+
+    cache.release();
+    if (boundary == 0)
+    {
+        return;
+    }
+
+    TRACE_SCOPE("cache_frozen", "training", boundary);
+    cache.reserve(boundary, TRAIN.samples, width, stride(width));
+    for (int sample = 0; sample < TRAIN.samples; sample += 1)
+    {
+        bind_sample(TRAIN, sample, true);                                                   /// Samples are visited in order, so the feature layers run in batches
+        forward_from(1);
+        std::copy_n(a[boundary], width, cache.row(sample));
+    }
+
+    std::cout << "\n[FREEZE] [LAYERS " << boundary << " of " << layers.size() - 1 << "] Cached " << TRAIN.samples << " x " << width
+              << " activations (" << std::fixed << std::setprecision(1) << cache.bytes() / (1024.0 * 1024.0) << " MiB) in "
+              << std::setprecision(3) << omp_get_wtime() - start << " seconds\n";
+}
@@ -0,0 +1,174 @@
+
+#include "idx.hpp"
+
+#include <zlib.h>                                   /// inflateInit2(), inflate()
+#include <fcntl.h>                                  /// open()
+#include <unistd.h>                                 /// close()
+#include <sys/mman.h>                               /// mmap(), madvise()
+#include <sys/stat.h>                               /// fstat()
+
+/**
+ * Maps an IDX file into memory, and inflates it if it is compressed.
+ *
+ * @param[in] filename the filepath of the IDX file, raw or compressed with gzip
+ *
+ * @note    The kernel is told that a raw file is about to be read whole, so the pages are
+ *          read ahead of the first access. A file is recognized as compressed by the gzip
+ *          signature, whatever its extension.
+ */
+void idx_file::open(const char* filename)
+{
+    struct stat status;
+
+    close();
+    filepath = filename;
+    int fd = ::open(filename, O_RDONLY);
+    if (fd < 0 || fstat(fd, &status) != 0 || status.st_size < 8)
+    {
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+        throw std::runtime_error("idx: cannot open " + filepath);
+    }
+    mapped_bytes = status.st_size;
+    void* address = mmap(nullptr, mapped_bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);                                                                        /// The mapping outlives the descriptor
+    if (address == MAP_FAILED)
+    {
+        mapped_bytes = 0;
+        throw std::runtime_error("idx: cannot map " + filepath);
+    }
+    mapped = (unsigned char*)address;
+    madvise(mapped, mapped_bytes, MADV_SEQUENTIAL);
+    madvise(mapped, mapped_bytes, MADV_WILLNEED);
+
+    compressed = mapped[0] == 0x1F && mapped[1] == 0x8B;
+    if (compressed)
+    {
+        inflate();
+        munmap(mapped, mapped_bytes);
+        mapped = nullptr;
+        mapped_bytes = 0;
+        return;
+    }
+    bytes = mapped;
+    size = mapped_bytes;
+}
+
+/**
+ * Inflates the mapped gzip file into `inflated`, streaming `IDX_INFLATE_CHUNK` bytes of the
+ * mapping at a time.
+ *
+ * @note    The last 4 (four) bytes of a gzip file hold the size of its contents (modulo 2^32),
+ *          so the buffer is allocated once. The buffer grows if the size turns out wrong.
+ */
+void idx_file::inflate(void)
+{
+    z_stream stream = {};
+    const unsigned char* trailer = mapped + mapped_bytes - 4;
+    size_t expected = (size_t)trailer[0] | (size_t)trailer[1] << 8 | (size_t)trailer[2] << 16 | (size_t)trailer[3] << 24;
+    size_t consumed = 0;
+    int status = Z_OK;
+
+    if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK)                                  /// Expects a gzip header
+    {
+        throw std::runtime_error("idx: cannot inflate " + filepath);
+    }
+    inflated.resize(std::max(expected, (size_t)8));
+    while (status != Z_STREAM_END)
+    {
+        if (stream.avail_in == 0 && consumed < mapped_bytes)
+        {
+            stream.next_in = mapped + consumed;
+            stream.avail_in = (uInt)std::min(IDX_INFLATE_CHUNK, mapped_bytes - consumed);
+            consumed += stream.avail_in;
+        }
+        if (stream.total_out == inflated.size())
+        {
+            inflated.resize(2 * inflated.size());
+        }
+        stream.next_out = inflated.data() + stream.total_out;
+        stream.avail_out = (uInt)std::min(inflated.size() - stream.total_out, (size_t)UINT32_MAX);
+        status = ::inflate(&stream, Z_NO_FLUSH);
+        if (status != Z_OK && status != Z_STREAM_END)
+        {
+            inflateEnd(&stream);
+            throw std::runtime_error("idx: corrupted " + filepath);
+        }
+    }
+    inflated.resize(stream.total_out);
+    inflateEnd(&stream);
+    bytes = inflated.data();
+    size = inflated.size();
+}
+
+/**
+ * Reads a big-endian word of the header of the IDX file.
+ *
+ * @param[in] index the index of the word (0 is the signature, then the size of every dimension)
+ *
+ * @return the word, in the host's byte order
+ */
+uint32_t idx_file::word(int index)
+{
+    if ((size_t)(index + 1) * 4 > size)
+    {
+        throw std::runtime_error("idx: truncated header: " + filepath);
+    }
+    const unsigned char* b = bytes + 4 * index;
+    return (uint32_t)b[0] << 24 | (uint32_t)b[1] << 16 | (uint32_t)b[2] << 8 | (uint32_t)b[3];
+}
+
+/**
+ * Releases the mapping and the inflated contents of the file.
+ */
+void idx_file::close(void)
+{
+    if (mapped != nullptr)
+    {
+        munmap(mapped, mapped_bytes);
+    }
+    mapped = nullptr;
+    mapped_bytes = 0;
+    inflated.clear();
+    inflated.shrink_to_fit();
+    bytes = nullptr;
+    size = 0;
+}
+
+/**
+ * Tells an IDX file, raw or compressed with gzip, from a CSV file.
+ *
+ * @param[in] filename the filepath of a dataset file
+ *
+ * @return `true` if the file starts with the gzip signature or with the 2 (two) zero bytes of an IDX signature
+ */
+bool is_idx(const char* filename)
+{
+    std::ifstream stream(filename, std::ios::binary);
+    unsigned char signature[2] = { 0xFF, 0xFF };
+
+    stream.read((char*)signature, 2);
+    return (signature[0] == 0x1F && signature[1] == 0x8B) || (signature[0] == 0x00 && signature[1] == 0x00);
+}
+
+/**
+ * Derives the filepath of the labels that come with an IDX file of images, following the
+ * naming of the MNIST distribution (`train-images-idx3-ubyte` and `train-labels-idx1-ubyte`).
+ *
+ * @param[in] images the filepath of the images
+ *
+ * @return the filepath of the labels
+ */
+std::string idx_labels_filepath(const std::string& images)
+{
+    std::string labels = images;
+    size_t at = labels.rfind("images-idx3");
+
+    if (at == std::string::npos)
+    {
+        throw std::runtime_error("idx: cannot find the labels of " + images + " (expected an images-idx3 file name)");
+    }
+    return labels.replace(at, std::string("images-idx3").size(), "labels-idx1");
+}
@@ -1,6 +1,8 @@
 
 #include "interface.hpp"
 
+#include <sstream>                                  /// std::ostringstream
+
 /**
  * Includes graphic libraries depending on the host's OS.
  * Sets up CLI environment and defines functions and modules
@@ -309,17 +311,39 @@ void progress_bar::indicate_progress(double checkpoint)
  * @param[in] epoch_loss the model's loss during a certain epoch of training or evaluation
  * @param[in] epoch_accuracy the model's accuracy during a certain epoch of training or evaluation
  * @param[in] benchmark the epoch's benchmark
+ * @param[in] held_out `true` if the stats are the evaluation of the model at the end of the epoch
+ *
+ * @note    The line is written at once, since the held-out stats are printed by the background
+ *          evaluator, while the training prints its own.
  */
-void print_epoch_stats(int epoch, double epoch_loss, int epoch_accuracy, double benchmark)
+void print_epoch_stats(int epoch, double epoch_loss, int epoch_accuracy, double benchmark, bool held_out)
 {
+    std::ostringstream line;
+
     if (epoch == -1)
     {
-        std::cout << "\n\n[EVALUATION] [LOSS " << std::fixed << std::setprecision(5) << epoch_loss << "] [ACCURACY " << std::setw(6) << epoch_accuracy << " out of " << (int)MNIST_TEST << "] Work took " << std::setw(4) << (int)benchmark << " seconds";
+        line << "\n\n[EVALUATION] [LOSS " << std::fixed << std::setprecision(5) << epoch_loss << "] [ACCURACY " << std::setw(6) << epoch_accuracy << " out of " << (int)MNIST_TEST << "] Work took " << std::setw(8) << std::setprecision(3) << benchmark << " seconds";
+    }
+    else if (held_out)
+    {
+        line << "\n[HELD-OUT " << std::setw(4) << epoch << "] [LOSS " << std::fixed << std::setprecision(5) << epoch_loss << "] [ACCURACY " << std::setw(6) << epoch_accuracy << " out of " << (int)MNIST_TEST << "] Work took " << std::setw(8) << std::setprecision(3) << benchmark << " seconds";
     }
     else
     {
-        std::cout << "\n[EPOCH " << std::setw(4) << epoch << "] [LOSS " << std::fixed << std::setprecision(5) << epoch_loss << "] [ACCURACY " << std::setw(6) << epoch_accuracy << " out of " << (int)MNIST_TRAIN << "] Work took " << std::setw(4) << (int)benchmark << " seconds";
+        line << "\n[EPOCH " << std::setw(4) << epoch << "] [LOSS " << std::fixed << std::setprecision(5) << epoch_loss << "] [ACCURACY " << std::setw(6) << epoch_accuracy << " out of " << (int)MNIST_TRAIN << "] Work took " << std::setw(8) << std::setprecision(3) << benchmark << " seconds";
     }
+    std::cout << line.str() << std::flush;
+}
+
+/**
+ * Prints the density of the training inputs along with the kernels selected for the first layer.
+ *
+ * @param[in] density the average fraction of non-zero inputs per sample
+ * @param[in] sparse `true` if the sparse kernels have been selected
+ */
+void print_input_stats(double density, bool sparse)
+{
+    std::cout << "\n\n[INPUT] [DENSITY " << std::fixed << std::setprecision(3) << density << "] Using the " << (sparse ? "sparse" : "dense") << " kernels of the first layer\n";
 }
 
 /**
@@ -332,8 +356,29 @@ void print_epoch_stats(int epoch, double epoch_loss, int epoch_accuracy, double
 void usage(char* filename)
 {
     std::cout << "Usage of " << filename << ":\n";
+    std::cout << "\t" << filename << " [options]\t\t\t Trains and evaluates a model.\n";
+    std::cout << "\t" << filename << " sweep <file> [options]\t Trains the configurations of a file (hidden layers, learning rate, epochs per line) with successive halving.\n";
+    std::cout << "\t" << filename << " score <checkpoint> <input> <output> [options]\t Scores a CSV file (or \'-\' for the standard input) with a saved model, into a CSV file (or \'-\').\n";
+    std::cout << "\t" << filename << " online <source> [options]\t Trains a model on labelled CSV rows as they arrive on the standard input (\'-\') or on a Unix socket, publishing it as a checkpoint.\n";
     std::cout << "\t:option \'-i\': integer \t - \t The size of the input layer for the neural network.\n";
     std::cout << "\t:option \'-h\': integer \t - \t The size of a hidden layer for the neural network.\n\t\t\t\t\t There can be multiple hidden layers. For every hidden layer, use this option.\n";
+    std::cout << "\t:option \'-k\': integer \t - \t The number of filters of a 3x3 convolution in front of the hidden layers. There can be multiple feature layers.\n";
+    std::cout << "\t:option \'-m\': integer \t - \t The window size of a max pooling in front of the hidden layers. Feature layers run in the given order.\n";
     std::cout << "\t:option \'-o\': integer \t - \t The size of the output layer for the neural network.\n";
+    std::cout << "\t:option \'-t\': integer \t - \t The number of threads. By default, it is the number of logical processors.\n";
+    std::cout << "\t:option \'-p\': integer \t - \t The percentage of synapses to prune after training. By default, nothing is pruned.\n";
+    std::cout << "\t:option \'-l\': integer \t - \t The percentage of the spectral energy of every layer kept by a low-rank factorization after training. By default, nothing is factorized.\n";
+    std::cout << "\t:option \'-L\': integer \t - \t The highest rank of a factorized layer, which factorizes the model even without \'-l\'.\n";
+    std::cout << "\t:option \'-f\': integer \t - \t The number of epochs to fine-tune the factorized model for. By default, there are none.\n";
+    std::cout << "\t:option \'-z\': integer \t - \t Freezes the weights feeding a layer (1 for the first hidden layer). Frozen bottom layers are fed forward once per sample.\n";
+    std::cout << "\t:option \'-b\': integer \t - \t Skips the backward passes of fitted (low-loss) samples at random, keeping each with at least the given percentage of probability. By default, every pass is kept.\n";
+    std::cout << "\t:option \'-c\': integer \t - \t Writes a checkpoint in the background every given number of training steps.\n";
+    std::cout << "\t:option \'-C\': integer \t - \t Writes a checkpoint in the background every given number of seconds.\n";
+    std::cout << "\t:option \'-r\': string \t - \t Resumes the training from a checkpoint of a model with the same layers.\n";
+    std::cout << "\t:option \'-e\': integer \t - \t The number of background threads that score every epoch on the evaluation set. By default, there are none.\n";
+    std::cout << "\t:option \'-s\': integer \t - \t The number of pipeline stages to split the layers into for the training. By default, there is no pipeline.\n";
+    std::cout << "\t:option \'-d\': string \t - \t The training dataset: a CSV file, or the images of an IDX pair (e.g. train-images-idx3-ubyte.gz).\n";
+    std::cout << "\t:option \'-D\': string \t - \t The evaluation dataset: a CSV file, or the images of an IDX pair (e.g. t10k-images-idx3-ubyte.gz).\n";
+    std::cout << "\t:option \'-a\': string \t - \t The thread affinity policy: \'compact\' (default), \'scatter\' or \'none\'.\n";
     exit(8);
 }
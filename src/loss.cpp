@@ -16,6 +16,9 @@
 
 double nn::mse_loss(double* (&Y), int dim)
 {
+    PROFILE_SCOPE(PHASE_LOSS, 0);
+    TRACE_SCOPE("loss", "reduction", -1);
+
     double l = 0.0;                                                         /// Initializes loss variable (accumulator)
 #pragma omp simd reduction(+ : l)
     for (int i = 0; i < dim; i += 1)
@@ -0,0 +1,170 @@
+
+#include "lowrank.hpp"
+
+/**
+ * Decomposes a dense matrix into its singular vectors and values, with the one-sided Jacobi
+ * method: pairs of rows are rotated until every row is orthogonal to the others.
+ *
+ * @param[in] dense the dense matrix, one pointer per row
+ * @param[in] rows the number of rows to decompose
+ * @param[in] columns the number of columns to decompose
+ * @param[in] threads the number of threads of the rotations
+ *
+ * @note    Every sweep visits all pairs of rows in `rows - 1` (or `rows`, if odd) rounds of
+ *          disjoint pairs, ordered like a round-robin tournament, so the pairs of a round are
+ *          rotated in parallel. The rotations are accumulated into an orthogonal matrix `P`,
+ *          so that `W = P^T R`: the rows of `R` are the scaled right singular vectors, and
+ *          the rows of `P` the left ones. The full rank is kept until `rank` is set.
+ */
+void low_rank::factorize(double** dense, int rows, int columns, int threads)
+{
+    int players = rows + rows % 2;                                                      /// Pads an odd number of rows with a row that sits out
+    std::vector<double> R((size_t)rows * columns), P((size_t)rows * rows, 0.0), norms(rows);
+    std::vector<int> order(rows);
+
+    release();
+    this->rows = rows;
+    this->columns = columns;
+    components = rank = std::min(rows, columns);
+
+    for (int i = 0; i < rows; i += 1)
+    {
+        std::copy_n(dense[i], columns, R.data() + (size_t)i * columns);
+        P[(size_t)i * rows + i] = 1.0;
+    }
+
+    for (int sweep = 0; sweep < SVD_SWEEPS; sweep += 1)
+    {
+        int rotated = 0;
+        for (int round = 0; round < players - 1; round += 1)
+        {
+#pragma omp parallel for num_threads(threads) schedule(dynamic) reduction(+ : rotated)
+            for (int k = 0; k < players / 2; k += 1)
+            {
+                int p = k == 0 ? 0 : (k - 1 + round) % (players - 1) + 1;
+                int q = (players - 2 - k + round) % (players - 1) + 1;
+                if (p >= rows || q >= rows)
+                {
+                    continue;
+                }
+
+                double* u = R.data() + (size_t)p * columns, * v = R.data() + (size_t)q * columns;
+                double alpha = 0.0, beta = 0.0, gamma = 0.0;
+#pragma omp simd reduction(+ : alpha, beta, gamma)
+                for (int j = 0; j < columns; j += 1)
+                {
+                    alpha += u[j] * u[j];
+                    beta += v[j] * v[j];
+                    gamma += u[j] * v[j];
+                }
+                if (gamma == 0.0 || std::fabs(gamma) <= SVD_TOLERANCE * std::sqrt(alpha * beta))
+                {
+                    continue;
+                }
+
+                double zeta = (beta - alpha) / (2.0 * gamma);                           /// Rotates by the angle that makes the rows orthogonal
+                double t = (zeta >= 0.0 ? 1.0 : -1.0) / (std::fabs(zeta) + std::sqrt(1.0 + zeta * zeta));
+                double c = 1.0 / std::sqrt(1.0 + t * t), s = c * t;
+#pragma omp simd
+                for (int j = 0; j < columns; j += 1)
+                {
+                    double x = u[j], y = v[j];
+                    u[j] = c * x - s * y;
+                    v[j] = s * x + c * y;
+                }
+                double* pu = P.data() + (size_t)p * rows, * pv = P.data() + (size_t)q * rows;
+#pragma omp simd
+                for (int j = 0; j < rows; j += 1)
+                {
+                    double x = pu[j], y = pv[j];
+                    pu[j] = c * x - s * y;
+                    pv[j] = s * x + c * y;
+                }
+                rotated += 1;
+            }
+        }
+        if (rotated == 0)
+        {
+            break;
+        }
+    }
+
+    for (int i = 0; i < rows; i += 1)
+    {
+        const double* u = R.data() + (size_t)i * columns;
+        norms[i] = std::inner_product(u, u + columns, u, 0.0);
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](int x, int y) { return norms[x] > norms[y]; });
+
+    left = new double[(size_t)rows * components];
+    right = new double[(size_t)components * columns];
+    energy = new double[components];
+    projected = new double[components];
+    for (int j = 0; j < components; j += 1)
+    {
+        energy[j] = norms[order[j]];
+        std::copy_n(R.data() + (size_t)order[j] * columns, columns, right + (size_t)j * columns);
+        for (int i = 0; i < rows; i += 1)
+        {
+            left[(size_t)i * components + j] = P[(size_t)order[j] * rows + i];
+        }
+    }
+}
+
+/**
+ * Finds the smallest rank that keeps a fraction of the energy of the matrix.
+ *
+ * @param[in] kept the fraction of the sum of the squared singular values to keep
+ *
+ * @return the rank, at least 1 (one)
+ */
+int low_rank::rank_for(double kept) const
+{
+    double total = std::accumulate(energy, energy + components, 0.0), sum = 0.0;
+    int k = 0;
+
+    while (k < components && (k == 0 || sum < kept * total))
+    {
+        sum += energy[k];
+        k += 1;
+    }
+    return kept >= 1.0 ? components : k;
+}
+
+/**
+ * Writes the product of the truncated factors into a dense matrix.
+ *
+ * @param[in, out] dense the dense matrix, one pointer per row, of which the first `columns` columns are overwritten
+ */
+void low_rank::reconstruct(double** dense) const
+{
+    for (int i = 0; i < rows; i += 1)
+    {
+        double* w = dense[i];
+        std::fill_n(w, columns, 0.0);
+        for (int j = 0; j < rank; j += 1)
+        {
+            double scale = left[(size_t)i * components + j];
+            const double* r = right + (size_t)j * columns;
+#pragma omp simd
+            for (int c = 0; c < columns; c += 1)
+            {
+                w[c] += scale * r[c];
+            }
+        }
+    }
+}
+
+/**
+ * Releases the factors.
+ */
+void low_rank::release(void)
+{
+    delete[] left;
+    delete[] right;
+    delete[] energy;
+    delete[] projected;
+    left = right = energy = projected = nullptr;
+    rows = columns = components = rank = 0;
+}
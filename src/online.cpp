@@ -0,0 +1,368 @@
+
+#include "online.hpp"
+
+#include <poll.h>                                   /// poll()
+#include <fcntl.h>                                  /// O_CLOEXEC
+#include <unistd.h>                                 /// read(), close(), unlink()
+#include <sys/un.h>                                 /// sockaddr_un
+#include <sys/socket.h>                             /// socket(), bind(), listen(), accept4()
+
+static volatile sig_atomic_t stop_requested = 0;    /// Set by SIGINT and SIGTERM, polled by the ingest
+
+/**
+ * Requests the learner to stop, once the samples already read are trained on.
+ */
+static void request_stop(int)
+{
+    stop_requested = 1;
+}
+
+/**
+ * Compiles the model, or loads it from a checkpoint, and opens the source of the samples.
+ *
+ * @param[in] source_name `-` for the standard input, or the filepath of a Unix socket to listen on
+ * @param[in] l the layer structure of the model, unless it is resumed from a checkpoint (`-r`)
+ *
+ * @note    The model is published with the checkpointer, every `ONLINE_SNAPSHOT_SECONDS`
+ *          unless `-c` or `-C` is given. Feature layers are not supported, since the
+ *          checkpoints do not hold them.
+ */
+void learner::open(const char* source_name, const std::vector<int>& l)
+{
+    struct sigaction action = {};
+
+    if (!model.features.empty())
+    {
+        throw std::runtime_error("online: feature layers cannot be published, use fully connected layers only");
+    }
+    if (!model.resume_filepath.empty())
+    {
+        model.load(model.resume_filepath.c_str());                                      /// Compiles the model from the checkpoint
+    }
+    else if (l.size() >= 3)
+    {
+        model.compile(l, -1.0, 1.0);
+    }
+    else
+    {
+        throw std::runtime_error("online: give the layers of the model (-i, -h, -o), or a checkpoint to resume from (-r)");
+    }
+
+    source = source_name;
+    if (source != "-")
+    {
+        listen(source_name);
+    }
+    action.sa_handler = request_stop;                                                   /// Without SA_RESTART, so that a blocked poll returns
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    target.assign(model.layers.back(), 0.0);
+    slots.resize(ONLINE_QUEUE);
+    for (auto& slot : slots)
+    {
+        slot.x.resize(model.layers[0] - 1);
+        empty.push(&slot);
+    }
+
+    if (model.checkpoints.every_steps == 0 && model.checkpoints.every_seconds == 0.0)
+    {
+        model.checkpoints.every_seconds = ONLINE_SNAPSHOT_SECONDS;
+    }
+    model.checkpoints.open(model.layers, model.parameter_bytes);
+}
+
+/**
+ * Listens for the clients of the learner on a Unix socket.
+ *
+ * @param[in] path the filepath of the socket, which replaces any file of the same name
+ */
+void learner::listen(const char* path)
+{
+    sockaddr_un address = {};
+
+    if (strlen(path) >= sizeof(address.sun_path))
+    {
+        throw std::runtime_error("online: socket path too long: " + source);
+    }
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+    unlink(path);                                                                       /// Removes the socket of an earlier run
+
+    listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener < 0 || bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || ::listen(listener, ONLINE_BACKLOG) != 0)
+    {
+        throw std::runtime_error("online: cannot listen on " + source + ": " + strerror(errno));
+    }
+}
+
+/**
+ * Implements the ingest thread: reads the rows of the source into sample slots, and hands
+ * them to the training thread, until the source ends or the learner is interrupted.
+ *
+ * @note    Every ready source is read `ONLINE_READ_BUFFER` bytes at a time, and only its
+ *          complete rows are parsed; the rest waits for the next read. A row is timestamped
+ *          when it is read, so the latency includes the wait for a free slot.
+ */
+void learner::ingest(void)
+{
+    std::vector<pollfd> sources;
+    std::vector<std::string> pending;                                                   /// Bytes of the incomplete row of every source
+    std::vector<char> buffer(ONLINE_READ_BUFFER);
+
+    sources.push_back({ listener >= 0 ? listener : STDIN_FILENO, POLLIN, 0 });
+    pending.emplace_back();
+    while (!stop_requested && !sources.empty())
+    {
+        if (poll(sources.data(), sources.size(), ONLINE_POLL_MS) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        for (size_t i = sources.size(); i-- > 0;)
+        {
+            if (sources[i].revents == 0)
+            {
+                continue;
+            }
+            if (sources[i].fd == listener)
+            {
+                int client = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+                if (client >= 0)
+                {
+                    sources.push_back({ client, POLLIN, 0 });
+                    pending.emplace_back();
+                }
+                continue;
+            }
+
+            ssize_t got = read(sources[i].fd, buffer.data(), buffer.size());
+            if (got < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (got > 0)
+            {
+                pending[i].append(buffer.data(), got);
+                consume(pending[i]);
+                continue;
+            }
+            pending[i].push_back('\n');                                                 /// Ends the last row of the source, if it is not
+            consume(pending[i]);
+            if (sources[i].fd != STDIN_FILENO)
+            {
+                ::close(sources[i].fd);
+            }
+            sources.erase(sources.begin() + i);
+            pending.erase(pending.begin() + i);
+        }
+    }
+    for (auto& client : sources)
+    {
+        if (client.fd != listener && client.fd != STDIN_FILENO)
+        {
+            ::close(client.fd);
+        }
+    }
+    ready.close();
+}
+
+/**
+ * Parses the complete rows of a source into sample slots, and hands them to the training thread.
+ *
+ * @param[in, out] pending the bytes read from the source, of which the complete rows are removed
+ *
+ * @note    Blocks while every slot is taken, so a source faster than the training is held back.
+ *          Stops if the slots are closed, since nothing is trained any more.
+ */
+void learner::consume(std::string& pending)
+{
+    int inputs = model.layers[0] - 1, outputs = model.layers.back();
+    double arrival = omp_get_wtime();
+    size_t begin = 0, end;
+    online_sample* sample;
+
+    while ((end = pending.find('\n', begin)) != std::string::npos)
+    {
+        char* line = &pending[begin];
+        pending[end] = '\0';
+        begin = end + 1;
+        if (*line == '\0' || *line == '\r' || std::isalpha((unsigned char)*line))      /// Skips blank rows and headers
+        {
+            continue;
+        }
+
+        if (!empty.pop(sample))
+        {
+            break;
+        }
+        received += 1;
+        if (!parse_sample(line, inputs + 1, true, sample->x.data(), sample->label) || sample->label < 0 || sample->label >= outputs)
+        {
+            malformed += 1;
+            empty.push(sample);
+            continue;
+        }
+        sample->arrival = arrival;
+        ready.push(sample);
+    }
+    pending.erase(0, begin);
+}
+
+/**
+ * Trains the model on a mini-batch of samples, one sample after the other, and returns
+ * their slots to the ingest.
+ *
+ * @param[in, out] batch the samples of the update
+ *
+ * @note    Every sample is scored before the model is updated with it.
+ */
+void learner::update(std::vector<online_sample*>& batch)
+{
+    int outputs = model.layers.back();
+    double* Y = target.data();
+
+    TRACE_SCOPE("online_update", "training", -1);
+    for (auto sample : batch)
+    {
+        double* X = sample->x.data();
+        std::fill(target.begin(), target.end(), 0.0);
+        target[sample->label] = 1.0;
+
+        model.bind_input(X);
+        model.forward();
+        window_loss += model.mse_loss(Y, outputs);
+        window_correct += model.accuracy(Y, outputs);
+        model.back_propagation_update(Y);
+        model.checkpoints.tick(model.memory.base);                                      /// Publishes the model, if a snapshot is due
+    }
+
+    double done = omp_get_wtime();
+    for (auto sample : batch)
+    {
+        double latency = done - sample->arrival;
+        latencies.push_back(latency);
+        latency_sum += latency;
+        latency_max = std::max(latency_max, latency);
+        empty.push(sample);
+    }
+    samples += batch.size();
+    updates += 1;
+    window_samples += batch.size();
+    window_updates += 1;
+}
+
+/**
+ * Trains the model on the samples of the source as they arrive, until the source ends or
+ * the learner is interrupted, and publishes the last model.
+ *
+ * @note    An update takes the samples that have arrived, up to `ONLINE_BATCH`, and never
+ *          waits for more, so the latency of a sample is bounded by the time of a full batch.
+ *          The ingest thread is not pinned to the thread team's logical processors.
+ */
+void learner::run(void)
+{
+    std::vector<online_sample*> batch;
+    online_sample* sample;
+
+    start = window_start = omp_get_wtime();
+    reader = std::thread([this]() {
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (auto& cpu : host.cpus)
+        {
+            CPU_SET(cpu, &set);
+        }
+        sched_setaffinity(0, sizeof(set), &set);
+#endif
+        ingest();
+    });
+
+    while (ready.pop(sample))
+    {
+        batch.assign(1, sample);
+        while ((int)batch.size() < ONLINE_BATCH && ready.try_pop(sample))
+        {
+            batch.push_back(sample);
+        }
+        update(batch);
+
+        double now = omp_get_wtime();
+        if (now - window_start >= ONLINE_REPORT_SECONDS)
+        {
+            report_window(now);
+        }
+    }
+    reader.join();
+    seconds = omp_get_wtime() - start;
+    if (window_samples > 0)
+    {
+        report_window(omp_get_wtime());
+    }
+    model.checkpoints.take(model.memory.base);                                          /// Publishes the last model
+    model.checkpoints.close();
+}
+
+/**
+ * Prints the rates, the progressive loss and accuracy, and the latencies of the updates
+ * since the previous report, and starts the next report.
+ *
+ * @param[in] now the time of the report
+ */
+void learner::report_window(double now)
+{
+    double elapsed = std::max(now - window_start, 1e-9);
+    size_t n = latencies.size();
+    std::ios state(nullptr);
+
+    std::sort(latencies.begin(), latencies.end());
+    state.copyfmt(std::cout);
+    std::cout << "[ONLINE] [SAMPLES " << samples << "] " << std::fixed << std::setprecision(0)
+              << "[UPDATES/S " << window_updates / elapsed << "] [SAMPLES/S " << window_samples / elapsed << "] "
+              << std::setprecision(5) << "[LOSS " << window_loss / std::max(window_samples, 1L) << "] "
+              << "[ACCURACY " << window_correct << " out of " << window_samples << "] " << std::setprecision(3)
+              << "Latency p50 " << (n > 0 ? 1e3 * latencies[n / 2] : 0.0) << " ms, p99 "
+              << (n > 0 ? 1e3 * latencies[std::min(n - 1, n * 99 / 100)] : 0.0) << " ms, max "
+              << (n > 0 ? 1e3 * latencies[n - 1] : 0.0) << " ms" << std::endl;
+    std::cout.copyfmt(state);
+
+    latencies.clear();
+    window_samples = window_updates = 0;
+    window_correct = 0;
+    window_loss = 0.0;
+    window_start = now;
+}
+
+/**
+ * Prints the samples learned from, the rates of the whole run, and the published snapshots.
+ */
+void learner::report(void)
+{
+    std::ios state(nullptr);
+
+    state.copyfmt(std::cout);
+    std::cout << "\n[ONLINE] [RECEIVED " << received << "] [MALFORMED " << malformed << "] [UPDATES " << updates << "] "
+              << std::fixed << std::setprecision(0) << "[UPDATES/S " << updates / std::max(seconds, 1e-9) << "] "
+              << "[SAMPLES/S " << samples / std::max(seconds, 1e-9) << "] " << std::setprecision(3)
+              << "Ingest-to-update latency " << 1e3 * latency_sum / std::max(samples, 1L) << " ms on average (max "
+              << 1e3 * latency_max << " ms), over " << seconds << " seconds from " << (listener >= 0 ? source : "the standard input") << "\n";
+    std::cout.copyfmt(state);
+    model.checkpoints.report();
+}
+
+/**
+ * Stops listening, and removes the socket.
+ */
+void learner::close(void)
+{
+    if (listener >= 0)
+    {
+        ::close(listener);
+        unlink(source.c_str());
+        listener = -1;
+    }
+}
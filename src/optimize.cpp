@@ -1,91 +1,237 @@
 
 #include "neural.hpp"
 
+/**
+ * Propagates the error of the neurons fed by a weight matrix back to the matrix's inputs.
+ *
+ * @param[in] matrix the index of the weight matrix
+ * @param[out] err the error of the inputs of the matrix (the bias excluded)
+ * @param[in] fused if `true`, the matrix is also updated, row by row, right after every row propagates its error
+ *
+ * @note    The matrix is walked row by row, in the order it is stored: every neuron adds its
+ *          row, weighted by its error, to a partial sum of the thread. The partial sums of the
+ *          threads are then added together, so every weight is read once, contiguously and with
+ *          SIMD, just like in `forward()`. A single thread accumulates into `err` directly.
+ *
+ * @note    A fused update reads a synapse, adds it to the error and then updates it, while the row is
+ *          still in the cache. The error is propagated through the weights before their update, so the
+ *          gradient is the same as with `back_propagation()` followed by `optimize()`, while the matrix is
+ *          streamed once instead of twice.
+ *
+ * @note    If the inputs are the neurons of a hidden layer, their error is filtered by the
+ *          derivative of the activation function in the same pass. The inputs of the first
+ *          matrix are left unfiltered (they are the output of the feature layers, if any).
+ */
+void nn::propagate(int matrix, double* err, bool fused)
+{
+    int columns = layers[matrix] - 1, ld = stride(columns);
+    int rows = matrix == layers.size() - 2 ? layers[matrix + 1] : layers[matrix + 1] - 1;
+    int team = plan(matrix, rows, fused ? 2.0 * columns : columns);
+
+    PROFILE_STRATEGY(PHASE_BACK_PROPAGATION, matrix, strategy(matrix, team));
+#pragma omp parallel num_threads(team) if(team > 1)
+    {
+        TRACE_SCOPE(fused ? "backward_update" : "backward", "reduction", matrix);
+        int members = omp_get_num_threads();                                            /// The runtime may grant fewer threads than planned
+        double* acc = members == 1 ? err : partial + (size_t)omp_get_thread_num() * ld;
+        double* in = a[matrix];
+
+        std::fill_n(acc, columns, 0.0);
+#pragma omp for schedule(runtime)
+        for (int neuron = 0; neuron < rows; neuron += 1)
+        {
+            double* w = weights[matrix][neuron];
+            double d = delta[matrix][neuron];
+            if (fused)
+            {
+                double step = learning_rate * d;
+#pragma omp simd
+                for (int synapse = 0; synapse < columns; synapse += 1)                                                                      /// Propagates through the synapse, then updates it
+                {
+                    acc[synapse] += w[synapse] * d;
+                    w[synapse] -= step * in[synapse];
+                }
+                w[columns] -= step;                                                                                                         /// Updates the synapse of the bias
+                continue;
+            }
+#pragma omp simd
+            for (int synapse = 0; synapse < columns; synapse += 1)                                                                          /// Adds the row, weighted by the neuron's error
+            {
+                acc[synapse] += w[synapse] * d;
+            }
+        }
+
+#pragma omp for schedule(static) nowait
+        for (int synapse = 0; synapse < columns; synapse += 1)                                                                              /// Adds the partial sums of the threads together
+        {
+            double REGISTER = err[synapse];
+            if (members > 1)
+            {
+                REGISTER = 0.0;
+                for (int thread = 0; thread < members; thread += 1)
+                {
+                    REGISTER += partial[(size_t)thread * ld + synapse];
+                }
+            }
+            err[synapse] = matrix > 0 ? REGISTER * sig_derivative(a[matrix][synapse]) : REGISTER;
+        }
+    }
+}
+
+/**
+ * Computes the error of the neurons of the output layer.
+ *
+ * @param[in, out] Y the expected output of the model for a given input
+ *
+ * @note Although passed by reference, the `Y` placeholder is not altered.
+ */
+void nn::output_error(double* (&Y))
+{
+    PROFILE_SCOPE(PHASE_BACK_PROPAGATION, layers.size() - 1);
+    int team = plan(layers.size() - 2, layers[layers.size() - 1], 1.0);
+    PROFILE_STRATEGY(PHASE_BACK_PROPAGATION, layers.size() - 1, strategy(layers.size() - 2, team));
+#pragma omp parallel num_threads(team) if(team > 1)
+    {
+        TRACE_SCOPE("output_error", "kernel", layers.size() - 1);
+#pragma omp for schedule(runtime) nowait
+        for (int neuron = 0; neuron < layers[layers.size() - 1]; neuron += 1)
+        {
+            delta[layers.size() - 2][neuron] = (a[layers.size() - 1][neuron] - Y[neuron]) * sig_derivative(a[layers.size() - 1][neuron]);               /// Computes the error of the neurons in the last layer
+        }
+    }
+}
+
 /**
  * Computes each neuron's error of a given neural network.
 
  * @param[in, out] Y the expected output of the model for a given input
- * 
+ *
  * @note Although passed by reference, the `Y` placeholder is not altered.
  *
- * @note    Using the `REGISTER` variable, we can take advantage of the `reduction()` routine.
- *          The `delta` container is not contiguous and therefore cannot be 'reduced'.
+ * @note    The error of every hidden layer is propagated back from the next layer by `propagate()`,
+ *          which follows the storage order of the weights.
  *
- * @note    Although there was no need for the purposes of the project to compute the error of more
- *          than 1 (one) hidden layers, there is a loop that does exactly that, for completeness.
+ * @note    The bias of a layer receives no error from the next layer, hence the error is computed
+ *          for the neurons of a layer only, leaving out the bias (the last element).
+ *
+ * @note    The error stops at the lowest weight matrix that is not frozen, since no matrix below
+ *          it is updated.
  */
 void nn::back_propagation(double* (&Y))
 {
-#pragma omp parallel for num_threads(N_THREADS)
-    for (int neuron = 0; neuron < layers[layers.size() - 1]; neuron += 1)
+    int lowest = lowest_trainable();
+
+    output_error(Y);
+    for (int matrix = layers.size() - 2; matrix > lowest; matrix -= 1)                                                                                  /// Computes the error of the neurons of every hidden layer, from the last one
+    {
+        PROFILE_SCOPE(PHASE_BACK_PROPAGATION, matrix);
+        propagate(matrix, delta[matrix - 1], false);
+    }
+}
+
+/**
+ * Computes each neuron's error of a given neural network and optimizes its weights, in a single
+ * sweep over every weight matrix. This is the backward pass of a training step, and is equivalent
+ * to `back_propagation()` followed by `optimize()`.
+ *
+ * @param[in, out] Y the expected output of the model for a given input
+ *
+ * @note Although passed by reference, the `Y` placeholder is not altered.
+ *
+ * @note    Every matrix but the first one is updated by `propagate()` as it propagates its error.
+ *          The first matrix is updated on its own by `update()`, unless it has to propagate its error
+ *          to the feature layers, since that is the only path that supports the sparse inputs.
+ *
+ * @note    Frozen matrices propagate their error without being updated. The pass stops at the lowest
+ *          matrix that is not frozen, which is updated on its own: nothing below it is ever touched,
+ *          and freezing the first matrix freezes the feature layers too.
+ */
+void nn::back_propagation_update(double* (&Y))
+{
+    int lowest = lowest_trainable();
+
+    if (lowest == layers.size() - 1)
     {
-        delta[layers.size() - 2][neuron] = (a[layers.size() - 1][neuron] - Y[neuron]) * sig_derivative(a[layers.size() - 1][neuron]);               /// Computes the error of the neurons in the last layer
+        return;
     }
-#pragma omp parallel for num_threads(N_THREADS)
-    for (int synapse = 0; synapse < layers[layers.size() - 2]; synapse += 1)
+    output_error(Y);
+    for (int matrix = layers.size() - 2; matrix > lowest; matrix -= 1)
     {
-        double REGISTER = 0.0;
-#pragma omp simd reduction(+ : REGISTER)
-        for (int neuron = 0; neuron < layers[layers.size() - 1]; neuron += 1)
-        {
-            REGISTER += weights[layers.size() - 2][neuron][synapse] * delta[layers.size() - 2][neuron];                                             /// Computes the first factor of the error of neurons for the last *hidden* layer
-        }
-        delta[layers.size() - 3][synapse] = REGISTER;
+        PROFILE_SCOPE(PHASE_BACK_PROPAGATION, matrix);
+        propagate(matrix, delta[matrix - 1], !frozen[matrix]);
     }
-
-#pragma omp parallel for num_threads(N_THREADS)
-    for (int synapse = 0; synapse < layers[layers.size() - 2]; synapse += 1)
+    if (lowest > 0)
+    {
+        update(lowest);
+        return;
+    }
+    if (!features.empty())
     {
-        delta[layers.size() - 3][synapse] = delta[layers.size() - 3][synapse] * sig_derivative(a[layers.size() - 2][synapse]);                      /// Computes the total neuron error for each neuron in the last *hidden* layer
+        PROFILE_SCOPE(PHASE_BACK_PROPAGATION, 0);
+        propagate(0, features.back().err, true);                                                                                                   /// Computes the error of the output of the feature layers
+        return;
     }
+    update(0);
+}
 
-    for (int layer = 2; layer < layers.size() - 1; layer += 1)                                                                                      /// Computes the error for neurons in the remaining hidden layers using the same method
+/**
+ * Optimizes the weights of a weight matrix by subtracting the precomputed error corresponding to each neuron pair (synapse).
+ *
+ * @param[in] matrix the index of the weight matrix
+ *
+ * @note    The last synapse of every neuron connects it to the bias of the previous layer, whose
+ *          value is always 1 (one). That synapse is updated separately, so that the bias never has
+ *          to be stored next to the input, which is bound straight from the dataset.
+ *
+ * @note    If the input has been bound sparse, the synapses of the zero inputs are skipped
+ *          in the first layer, since their updates are zero.
+ */
+void nn::update(int matrix)
+{
+    int columns = layers[matrix] - 1;
+    int rows = matrix == layers.size() - 2 ? layers[matrix + 1] : layers[matrix + 1] - 1;
+
+    PROFILE_SCOPE(PHASE_OPTIMIZE, matrix + 1);
+    int team = plan(matrix, rows, matrix == 0 && input_nnz >= 0 ? input_nnz : columns);
+    PROFILE_STRATEGY(PHASE_OPTIMIZE, matrix + 1, strategy(matrix, team));
+#pragma omp parallel num_threads(team) if(team > 1)
     {
-#pragma omp parallel for num_threads(N_THREADS)
-        for (int synapse = 0; synapse < layers[layers.size() - layer - 1]; synapse += 1)
+        TRACE_SCOPE("optimize", "kernel", matrix + 1);
+#pragma omp for schedule(runtime) nowait
+        for (int neuron = 0; neuron < rows; neuron += 1)
         {
-            double REGISTER = 0.0;
-#pragma omp simd reduction(+ : REGISTER)
-            for (int neuron = 0; neuron < layers[layers.size() - layer] - 1; neuron += 1)                                                           /// There is no synapse between the bias at layer `l` and any neuron at layer `l - 1`
+            double* w = weights[matrix][neuron];
+            double step = learning_rate * delta[matrix][neuron];
+            if (matrix == 0 && input_nnz >= 0)                                                                                                      /// Only the synapses of non-zero inputs move in the first layer
             {
-                REGISTER += weights[layers.size() - layer - 1][neuron][synapse] * delta[layers.size() - layer - 1][neuron];
+#pragma omp simd
+                for (int k = 0; k < input_nnz; k += 1)                                                                                              /// The indices are unique, so the scatter never conflicts
+                {
+                    w[input_index[k]] -= step * input_value[k];
+                }
+                w[columns] -= step;
+                continue;
             }
-            delta[layers.size() - layer - 2][synapse] = REGISTER;
+#pragma omp simd
+            for (int synapse = 0; synapse < columns; synapse += 1)
+            {
+                w[synapse] -= step * a[matrix][synapse];                                                                                            /// Optimizes weights between those synapses
+            }
+            w[columns] -= step;                                                                                                                     /// Optimizes the synapse of the bias
         }
-
-#pragma omp parallel for num_threads(N_THREADS)
-        for (int synapse = 0; synapse < layers[layers.size() - layer - 1]; synapse += 1)
-        {
-            delta[layers.size() - layer - 2][synapse] = delta[layers.size() - layer - 2][synapse] * sig_derivative(a[layers.size() - layer - 1][synapse]);
-        }                                                                                                                          /// Deallocates memory space requested for the `REGISTER` container
     }
 }
 
 /**
- * Optimizes weights by subtracting the precomputed error corresponding to each neuron pair (synapse).
+ * Optimizes the weights of every weight matrix that is not frozen, from the last one.
  */
 void nn::optimize(void)
 {
-#pragma omp parallel for num_threads(N_THREADS)
-    for (int neuron = 0; neuron < layers[layers.size() - 1]; neuron += 1)                                                                           /// Loops through all neurons in the last layer
-    {
-#pragma omp simd
-        for (int synapse = 0; synapse < layers[layers.size() - 2]; synapse += 1)                                                                    /// Loops through all neurons in the last *hidden* layer
-        {
-            weights[layers.size() - 2][neuron][synapse] -= LEARNING_RATE * delta[layers.size() - 2][neuron] * a[layers.size() - 2][synapse];        /// Optimizes weights between those synapses
-        }
-    }
-
-    for (int layer = 2; layer < layers.size(); layer += 1)                                                                                          /// Loops through all the other layers
+    for (int matrix = layers.size() - 2; matrix >= 0; matrix -= 1)
     {
-#pragma omp parallel for num_threads(N_THREADS)
-        for (int neuron = 0; neuron < layers[layers.size() - layer] - 1; neuron += 1)
+        if (!frozen[matrix])
         {
-#pragma omp simd
-            for (int synapse = 0; synapse < layers[layers.size() - layer - 1]; synapse += 1)                                                        /// Uses the same method to optimize the rest of the model's synapses
-            {
-                weights[layers.size() - layer - 1][neuron][synapse] -= LEARNING_RATE * delta[layers.size() - layer - 1][neuron] * a[layers.size() - layer - 1][synapse];
-            }
+            update(matrix);
         }
     }
 }
@@ -29,8 +29,10 @@ int parse_integer(char* argv)
  * @param[in] argc the number of user arguments
  * @param[in] argv the vector of the user arguments
  * @param[in, out] vec the container to be given the neural network's structure
+ * @param[in, out] model the neural network to be given the rest of its settings
+ * @param[in, out] sources the filepaths of the training and the evaluation datasets, if the caller loads any
  */
-void parse_arguments(int argc, char* argv[], std::vector<int>& vec)
+void parse_arguments(int argc, char* argv[], std::vector<int>& vec, nn& model, std::string* sources)
 {
     char* filename = argv[0];
 
@@ -44,13 +46,114 @@ void parse_arguments(int argc, char* argv[], std::vector<int>& vec)
         case 'h':                                                                       /// '-h' option: This is used to give the size of a hidden layer of the model
             vec.push_back(parse_integer(&argv[2][0]) + 1);                              /// There can be more than one hidden layers, and all have to be initialized using the '-h' option
             break;
+        case 'k':                                                                       /// '-k' option: This is used to add a convolution of the given number of filters in front of the hidden layers
+        {
+            int filters = parse_integer(&argv[2][0]);
+            if (filters < 1)
+            {
+                usage(filename);
+            }
+            model.features.emplace_back(LAYER_CONV2D, filters, CONV_KERNEL);
+            break;
+        }
+        case 'm':                                                                       /// '-m' option: This is used to add a max pooling of the given window size in front of the hidden layers
+        {
+            int window = parse_integer(&argv[2][0]);
+            if (window < 1)
+            {
+                usage(filename);
+            }
+            model.features.emplace_back(LAYER_MAXPOOL, 0, window);
+            break;
+        }
         case 'o':                                                                       /// '-o' option: This is used to give an output size for the last layer of the model
             vec.push_back(parse_integer(&argv[2][0]));
             break;
+        case 't':                                                                       /// '-t' option: This is used to give the number of threads, overriding the runtime detection
+            host.threads = parse_integer(&argv[2][0]);
+            break;
+        case 'p':                                                                       /// '-p' option: This is used to give the percentage of synapses to be pruned after training
+            model.sparsity = parse_integer(&argv[2][0]) / 100.0;
+            break;
+        case 'l':                                                                       /// '-l' option: This is used to give the percentage of the spectral energy of every layer kept by a low-rank factorization after training
+            model.retained = parse_integer(&argv[2][0]) / 100.0;
+            break;
+        case 'L':                                                                       /// '-L' option: This is used to cap the rank of every factorized layer
+            model.max_rank = parse_integer(&argv[2][0]);
+            break;
+        case 'f':                                                                       /// '-f' option: This is used to give the epochs of training after the factorization
+            model.fine_tune = parse_integer(&argv[2][0]);
+            break;
+        case 'z':                                                                       /// '-z' option: This is used to freeze the weights feeding a layer (1 for the first hidden layer), and can be given more than once
+        {
+            int layer = parse_integer(&argv[2][0]);
+            if (layer < 1)
+            {
+                usage(filename);
+            }
+            if (model.frozen.size() < (size_t)layer)
+            {
+                model.frozen.resize(layer, false);
+            }
+            model.frozen[layer - 1] = true;
+            break;
+        }
+        case 'b':                                                                       /// '-b' option: This is used to give the lowest probability (percentage) of keeping the backward pass of a fitted sample, enabling the selective sampler
+            model.selective.floor = parse_integer(&argv[2][0]) / 100.0;
+            break;
+        case 'c':                                                                       /// '-c' option: This is used to write a checkpoint every given number of training steps
+            model.checkpoints.every_steps = parse_integer(&argv[2][0]);
+            break;
+        case 'C':                                                                       /// '-C' option: This is used to write a checkpoint every given number of seconds
+            model.checkpoints.every_seconds = parse_integer(&argv[2][0]);
+            break;
+        case 'r':                                                                       /// '-r' option: This is used to resume the training from a checkpoint
+            model.resume_filepath = argv[2];
+            break;
+        case 'e':                                                                       /// '-e' option: This is used to score the model on the evaluation set after every epoch, on the given number of background threads
+            model.held_out.workers = parse_integer(&argv[2][0]);
+            break;
+        case 's':                                                                       /// '-s' option: This is used to train through a pipeline of the given number of stages
+            model.stages = parse_integer(&argv[2][0]);
+            break;
+        case 'd':                                                                       /// '-d' option: This is used to give the training dataset (a CSV file, or the images of an IDX pair)
+        case 'D':                                                                       /// '-D' option: This is used to give the evaluation dataset (a CSV file, or the images of an IDX pair)
+            if (sources == nullptr)
+            {
+                usage(filename);
+            }
+            sources[argv[1][1] == 'd' ? 0 : 1] = argv[2];
+            break;
+        case 'a':                                                                       /// '-a' option: This is used to choose the thread affinity policy
+            if (strcmp(argv[2], "compact") == 0)
+            {
+                host.policy = AFFINITY_COMPACT;
+            }
+            else if (strcmp(argv[2], "scatter") == 0)
+            {
+                host.policy = AFFINITY_SCATTER;
+            }
+            else if (strcmp(argv[2], "none") == 0)
+            {
+                host.policy = AFFINITY_NONE;
+            }
+            else
+            {
+                usage(filename);
+            }
+            break;
         default:
             usage(filename);                                                            /// If given option is invalid, the program prints the usage and terminates execution
         }
         argv += 2;
         argc -= 2;
     }
+
+    bool frozen = std::find(model.frozen.begin(), model.frozen.end(), true) != model.frozen.end();
+    bool checkpointed = model.checkpoints.every_steps > 0 || model.checkpoints.every_seconds > 0.0;
+    if (model.stages > 1 && (!model.features.empty() || frozen || model.selective.active() || checkpointed))   /// Rejects the options the pipeline would silently drop
+    {
+        fprintf(stderr, "error - the pipeline (-s) cannot be combined with feature layers (-k, -m), frozen layers (-z), the selective sampler (-b) or checkpoints (-c, -C)\n");
+        usage(filename);
+    }
 }
@@ -0,0 +1,354 @@
+
+#include "pipeline.hpp"
+#include "neural.hpp"
+
+#include <thread>                                   /// std::this_thread::yield()
+
+/**
+ * Splits the model into stages and allocates the slots of the samples in flight.
+ *
+ * @param[in, out] model the model to be trained by the pipeline
+ * @param[in] requested the number of stages requested
+ *
+ * @note    The weight matrices are split into contiguous stages that minimize the
+ *          synapses of the heaviest stage, since the slowest stage sets the pace of
+ *          the whole pipeline. There can be no more stages than weight matrices.
+ *
+ * @note    The weights of a stage are a contiguous part of the model's parameter
+ *          region, so a stash is a single `memcpy()`, and a row of the stash is found
+ *          at the same distance from the stash as the row of the model from the stage's
+ *          weights. The last stage updates its weights right after every forward, hence
+ *          it never needs a stash.
+ */
+void pipeline::build(nn& model, int requested)
+{
+    int matrices = model.layers.size() - 1;
+    std::vector<double> cost(matrices + 1, 0.0);                                        /// Prefix sums of the synapses of the matrices
+    std::vector<std::vector<double>> best;
+    std::vector<std::vector<int>> cut;
+
+    stages = std::max(1, std::min(requested, matrices));
+    group = std::max(1, host.threads / stages);
+    for (int l = 0; l < matrices; l += 1)
+    {
+        int rows = l == matrices - 1 ? model.layers[l + 1] : model.layers[l + 1] - 1;
+        cost[l + 1] = cost[l] + (double)rows * model.layers[l];
+    }
+
+    best.assign(stages + 1, std::vector<double>(matrices + 1, std::numeric_limits<double>::infinity()));
+    cut.assign(stages + 1, std::vector<int>(matrices + 1, 0));
+    best[0][0] = 0.0;
+    for (int s = 1; s <= stages; s += 1)                                                /// Partitions the matrices into `s` stages, for every prefix
+    {
+        for (int i = s; i <= matrices; i += 1)
+        {
+            for (int j = s - 1; j < i; j += 1)
+            {
+                double heaviest = std::max(best[s - 1][j], cost[i] - cost[j]);
+                if (heaviest < best[s][i])
+                {
+                    best[s][i] = heaviest;
+                    cut[s][i] = j;
+                }
+            }
+        }
+    }
+    first.assign(stages + 1, matrices);
+    for (int s = stages, i = matrices; s > 0; i = cut[s][i], s -= 1)
+    {
+        first[s - 1] = cut[s][i];
+    }
+
+    offset.resize(stages);
+    bytes.resize(stages);
+    for (int s = 0; s < stages; s += 1)
+    {
+        char* begin = (char*)model.weights[first[s]][0];
+        char* end = first[s + 1] < matrices ? (char*)model.weights[first[s + 1]][0] : model.memory.base + model.parameter_bytes;
+        offset[s] = begin - model.memory.base;
+        bytes[s] = end - begin;
+    }
+
+    size_t footprint = 0;                                                               /// Sizes the arena of the slots
+    width = model.widest(model.layers);
+    footprint += arena::align(stages * sizeof(double**)) * 2 + arena::align(stages * stages * sizeof(double*));
+    footprint += arena::align((size_t)stages * group * width * sizeof(double));
+    for (int slot = 0; slot < stages; slot += 1)
+    {
+        footprint += arena::align((matrices + 1) * sizeof(double*)) + arena::align(matrices * sizeof(double*));
+        for (int l = 1; l <= matrices; l += 1)
+        {
+            footprint += arena::align(model.layers[l] * sizeof(double)) * 2;
+        }
+        for (int s = 0; s < stages - 1; s += 1)
+        {
+            footprint += arena::align(bytes[s]);
+        }
+    }
+    memory.reserve(footprint, ARENA_HUGETLB);
+
+    a = memory.allocate<double**>(stages);
+    delta = memory.allocate<double**>(stages);
+    stash = memory.allocate<double*>(stages * stages);
+    partial = memory.allocate<double>((size_t)stages * group * width);
+    for (int slot = 0; slot < stages; slot += 1)
+    {
+        a[slot] = memory.allocate<double*>(matrices + 1);
+        delta[slot] = memory.allocate<double*>(matrices);
+        a[slot][0] = nullptr;                                                           /// The input is bound straight from the dataset
+        for (int l = 1; l <= matrices; l += 1)
+        {
+            a[slot][l] = memory.allocate<double>(model.layers[l]);
+            delta[slot][l - 1] = memory.allocate<double>(model.layers[l]);
+        }
+        for (int s = 0; s < stages; s += 1)
+        {
+            stash[s * stages + slot] = s < stages - 1 ? (double*)memory.allocate(bytes[s]) : nullptr;
+        }
+    }
+
+    delete[] progress;
+    progress = new stage_progress[stages];
+
+    std::cout << "\n\nPipeline:\t\t[" << stages << " stages, " << group << " thread(s) per stage, 1F1B with weight stashing]\n";
+    for (int s = 0; s < stages; s += 1)
+    {
+        std::cout << "\tStage " << s << ":\tlayers " << first[s] << " to " << first[s + 1] << "\t("
+                  << (cost[first[s + 1]] - cost[first[s]]) / cost[matrices] * 100.0 << "% of the synapses)\n";
+    }
+}
+
+/**
+ * Feeds a sample forward through a stage, and stashes the weights it used.
+ *
+ * @param[in, out] model the model trained by the pipeline
+ * @param[in] stage the stage
+ * @param[in] slot the slot of the sample
+ */
+void pipeline::forward(nn& model, int stage, int slot)
+{
+    TRACE_SCOPE("forward", "pipeline", stage);
+    int matrices = model.layers.size() - 1;
+
+    if (stash[stage * stages + slot] != nullptr)
+    {
+        std::memcpy(stash[stage * stages + slot], model.memory.base + offset[stage], bytes[stage]);
+    }
+
+    for (int l = first[stage]; l < first[stage + 1]; l += 1)
+    {
+        int rows = l == matrices - 1 ? model.layers[l + 1] : model.layers[l + 1] - 1;
+        double* in = a[slot][l], * out = a[slot][l + 1];
+
+#pragma omp parallel for num_threads(group) if(group > 1) schedule(static)
+        for (int neuron = 0; neuron < rows; neuron += 1)
+        {
+            double* w = model.weights[l][neuron];
+            double REGISTER = w[model.layers[l] - 1];                                   /// Starts from the synapse of the previous layer's bias
+#pragma omp simd reduction(+ : REGISTER)
+            for (int synapse = 0; synapse < model.layers[l] - 1; synapse += 1)
+            {
+                REGISTER += w[synapse] * in[synapse];
+            }
+            out[neuron] = sigmoid(REGISTER);
+        }
+    }
+}
+
+/**
+ * Propagates the error of a sample back through a stage, and updates the stage's weights.
+ *
+ * @param[in, out] model the model trained by the pipeline
+ * @param[in] stage the stage
+ * @param[in] slot the slot of the sample
+ * @param[in] Y the expected output of the sample
+ *
+ * @note    The error is propagated through the weights the sample was fed forward with,
+ *          while the update is applied to the latest weights of the stage.
+ *
+ * @note    Like `nn::propagate()`, every matrix is walked row by row, in the order it is stored:
+ *          every neuron adds its stashed row, weighted by its error, to a partial sum of the
+ *          thread, and updates its latest row in the same pass, so the weights are streamed once.
+ *          The partial sums of the stage's threads are then added together. A single thread
+ *          accumulates into the error of the previous layer directly.
+ */
+void pipeline::backward(nn& model, int stage, int slot, double* Y)
+{
+    TRACE_SCOPE("backward", "pipeline", stage);
+    int matrices = model.layers.size() - 1;
+    double* scratch = partial + (size_t)stage * group * width;
+
+    for (int l = first[stage + 1] - 1; l >= first[stage]; l -= 1)
+    {
+        int rows = l == matrices - 1 ? model.layers[l + 1] : model.layers[l + 1] - 1;
+        int columns = model.layers[l] - 1;
+        double* err = delta[slot][l];
+        double* in = a[slot][l];
+        double* out_err = l > 0 ? delta[slot][l - 1] : nullptr;                         /// The input of the first matrix needs no error
+        double* stashed = stash[stage * stages + slot];
+        ptrdiff_t shift = stashed != nullptr ? stashed - (double*)(model.memory.base + offset[stage]) : 0;
+
+        if (l == matrices - 1)                                                          /// Computes the error of the output layer
+        {
+            for (int neuron = 0; neuron < rows; neuron += 1)
+            {
+                err[neuron] = (a[slot][l + 1][neuron] - Y[neuron]) * sig_derivative(a[slot][l + 1][neuron]);
+            }
+        }
+
+#pragma omp parallel num_threads(group) if(group > 1)
+        {
+            int members = omp_get_num_threads();
+            double* acc = members == 1 ? out_err : scratch + (size_t)omp_get_thread_num() * width;
+
+            if (out_err != nullptr)
+            {
+                std::fill_n(acc, columns, 0.0);
+            }
+#pragma omp for schedule(static)
+            for (int neuron = 0; neuron < rows; neuron += 1)
+            {
+                double* w = model.weights[l][neuron];
+                const double* ws = w + shift;                                           /// The row the sample was fed forward with
+                double d = err[neuron], step = model.learning_rate * d;
+                if (out_err != nullptr)
+                {
+#pragma omp simd
+                    for (int synapse = 0; synapse < columns; synapse += 1)              /// Propagates through the stashed synapse, then updates the latest one
+                    {
+                        acc[synapse] += ws[synapse] * d;
+                        w[synapse] -= step * in[synapse];
+                    }
+                }
+                else
+                {
+#pragma omp simd
+                    for (int synapse = 0; synapse < columns; synapse += 1)
+                    {
+                        w[synapse] -= step * in[synapse];
+                    }
+                }
+                w[columns] -= step;                                                     /// Updates the synapse of the bias
+            }
+
+            if (out_err != nullptr)
+            {
+#pragma omp for schedule(static) nowait
+                for (int synapse = 0; synapse < columns; synapse += 1)                  /// Adds the partial sums of the threads together
+                {
+                    double REGISTER = out_err[synapse];
+                    if (members > 1)
+                    {
+                        REGISTER = 0.0;
+                        for (int thread = 0; thread < members; thread += 1)
+                        {
+                            REGISTER += scratch[(size_t)thread * width + synapse];
+                        }
+                    }
+                    out_err[synapse] = REGISTER * sig_derivative(in[synapse]);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Trains the model for a single epoch through the pipeline. Every stage runs on its own
+ * thread (and its own group of threads for the kernels), and the stages hand the samples
+ * over to each other through their progress counters.
+ *
+ * @param[in, out] model the model trained by the pipeline
+ * @param[in, out] TRAIN the training dataset
+ * @param[in, out] gen the random generator that draws the samples
+ * @param[out] loss the average loss of the model over the epoch
+ * @param[out] validity the number of samples correctly classified during the epoch
+ *
+ * @return the time elapsed, in seconds
+ *
+ * @note    Up to `stages` samples are in flight, so the first stage sees weights that are up to
+ *          `stages - 1` updates behind the last one. This is the staleness traded for the overlap.
+ */
+double pipeline::train_epoch(nn& model, dataset(&TRAIN), std::mt19937& gen, double& loss, int& validity)
+{
+    double start = omp_get_wtime();
+    long samples = TRAIN.samples;
+    std::vector<int> order(samples);
+    std::uniform_int_distribution<> dist(0, TRAIN.samples - 1);
+    int L = model.layers.size() - 1;
+
+    for (auto& sample : order)                                                          /// Draws the random samples of the epoch up front
+    {
+        sample = dist(gen);
+    }
+    for (int s = 0; s < stages; s += 1)
+    {
+        progress[s].forwarded.store(0);
+        progress[s].backwarded.store(0);
+    }
+    loss = 0.0;
+    validity = 0;
+    omp_set_max_active_levels(2);                                                       /// Lets the kernels of a stage run on the stage's group of threads
+
+#pragma omp parallel num_threads(stages)
+    {
+        int stage = omp_get_thread_num();
+        long forwarded = 0, backwarded = 0;
+        long warmup = std::min((long)(stages - stage - 1), samples);
+
+        auto forward_next = [&]()
+        {
+            int slot = forwarded % stages;
+            while (stage > 0 && progress[stage - 1].forwarded.load(std::memory_order_acquire) <= forwarded)
+            {
+                std::this_thread::yield();                                              /// Waits for the sample to leave the previous stage
+            }
+            if (stage == 0)
+            {
+                a[slot][0] = TRAIN.X[order[forwarded]];
+            }
+            forward(model, stage, slot);
+            if (stage == stages - 1)                                                    /// Accounts for the loss and the accuracy of the sample
+            {
+                double* Y = TRAIN.Y[order[forwarded]], * out = a[slot][L];
+                int label = model.get_label(out);
+                for (int i = 0; i < TRAIN.classes; i += 1)
+                {
+                    loss += 0.5 * (Y[i] - out[i]) * (Y[i] - out[i]);
+                }
+                validity += Y[label] > 0.9 ? 1 : 0;
+            }
+            progress[stage].forwarded.store(forwarded + 1, std::memory_order_release);
+            forwarded += 1;
+        };
+
+        auto backward_next = [&]()
+        {
+            int slot = backwarded % stages;
+            while (stage < stages - 1 && progress[stage + 1].backwarded.load(std::memory_order_acquire) <= backwarded)
+            {
+                std::this_thread::yield();                                              /// Waits for the error of the sample from the next stage
+            }
+            backward(model, stage, slot, TRAIN.Y[order[backwarded]]);
+            progress[stage].backwarded.store(backwarded + 1, std::memory_order_release);
+            backwarded += 1;
+        };
+
+        TRACE_SCOPE("stage", "pipeline", stage);
+        for (long i = 0; i < warmup; i += 1)                                            /// Warm-up: fills the pipeline
+        {
+            forward_next();
+        }
+        while (forwarded < samples)                                                     /// Steady state: one forward, one backward
+        {
+            forward_next();
+            backward_next();
+        }
+        while (backwarded < samples)                                                    /// Cool-down: drains the pipeline
+        {
+            backward_next();
+        }
+    }
+
+    loss /= (samples + 0.0);
+    return omp_get_wtime() - start;
+}
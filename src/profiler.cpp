@@ -0,0 +1,353 @@
+
+#include "profiler.hpp"
+
+#ifdef __linux__
+#include <unistd.h>                                                                     /// read(), close()
+#include <sys/ioctl.h>                                                                  /// ioctl()
+#include <sys/syscall.h>                                                                /// SYS_perf_event_open
+#include <linux/perf_event.h>                                                           /// perf_event_attr
+#endif
+
+profiler prof;
+
+static const char* phase_names[N_PHASES] = { "forward", "back_propagation", "optimize", "loss", "accuracy" };
+
+/**
+ * Fetches the counters of the calling thread. On the first call of
+ * a thread, the counters are allocated and registered with the profiler.
+ *
+ * @return the counters private to the calling thread
+ */
+profile_counters& profiler::local(void)
+{
+    static thread_local profile_counters* mine = nullptr;
+
+    if (mine == nullptr)
+    {
+        mine = new profile_counters();                                                  /// Value initialization zeroes every counter
+        std::lock_guard<std::mutex> guard(lock);
+        counters.push_back(mine);
+    }
+    return *mine;
+}
+
+#ifdef __linux__
+/**
+ * Opens a hardware event for the calling thread.
+ *
+ * @param[in] type the type of the event
+ * @param[in] config the event's configuration
+ * @param[in] leader the file descriptor of the group leader or -1 to open a new group
+ *
+ * @return the file descriptor of the event or -1 if the event is not supported
+ */
+static int open_event(uint32_t type, uint64_t config, int leader)
+{
+    struct perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = leader == -1 ? 1 : 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+}
+
+/**
+ * Fetches the vendor of the host's processor.
+ *
+ * @return the `vendor_id` field of `/proc/cpuinfo`
+ */
+static std::string cpu_vendor(void)
+{
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+
+    while (std::getline(cpuinfo, line))
+    {
+        if (line.rfind("vendor_id", 0) == 0)
+        {
+            return line.substr(line.find(':') + 2);
+        }
+    }
+    return "";
+}
+#endif
+
+/**
+ * Opens an event group for every thread of the OpenMP team. A group holds the
+ * retired instructions, the last level cache misses and, on Intel and AMD processors,
+ * the retired floating point operations of the thread.
+ *
+ * @param[in] threads the number of threads of the OpenMP team
+ *
+ * @note    If the `NN_PERF_EVENTS` environment variable is not set, or the host does not
+ *          allow access to the counters (see `/proc/sys/kernel/perf_event_paranoid`),
+ *          the profiler falls back to timing the phases only.
+ */
+void profiler::enable_hardware(int threads)
+{
+#ifdef __linux__
+    if (getenv("NN_PERF_EVENTS") == NULL)
+    {
+        return;
+    }
+
+    std::vector<std::pair<uint64_t, int>> raw;                                          /// Raw floating point events and the operations each one of them counts
+    std::string vendor = cpu_vendor();
+    if (vendor == "GenuineIntel")
+    {
+        raw = { { 0x01C7, 1 }, { 0x04C7, 2 }, { 0x10C7, 4 }, { 0x40C7, 8 } };           /// FP_ARITH_INST_RETIRED: scalar, 128, 256 and 512 bit packed double
+    }
+    else if (vendor == "AuthenticAMD")
+    {
+        raw = { { 0xFF03, 1 } };                                                        /// RETIRED_SSE_AVX_FLOPS
+    }
+
+    disable_hardware();                                                                 /// Closes the groups of an earlier call
+    perf_groups.assign(threads, -1);
+    perf_fds.assign(threads, std::vector<int>());
+    perf_kinds = { -1, -2 };
+    for (auto& event : raw)
+    {
+        perf_kinds.push_back(event.second);
+    }
+
+    bool ok = true;
+#pragma omp parallel num_threads(threads) reduction(&& : ok)
+    {
+        std::vector<int>& fds = perf_fds[omp_get_thread_num()];
+        int leader = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, -1);
+        ok = leader != -1;
+        if (ok)
+        {
+            fds.push_back(leader);
+            fds.push_back(open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, leader));
+            ok = fds.back() != -1;
+        }
+        for (auto& event : raw)
+        {
+            if (ok)
+            {
+                fds.push_back(open_event(PERF_TYPE_RAW, event.first, leader));
+                ok = fds.back() != -1;
+            }
+        }
+        if (ok)
+        {
+            ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+        perf_groups[omp_get_thread_num()] = leader;
+    }
+
+    hardware = ok;
+    if (!ok)
+    {
+        disable_hardware();                                                             /// Closes the events the threads did open
+        std::cout << "\nHardware counters are not available, profiling with timers only\n";
+    }
+#endif
+}
+
+/**
+ * Closes the event groups of every thread, and falls back to timing the phases only.
+ */
+void profiler::disable_hardware(void)
+{
+#ifdef __linux__
+    for (auto& fds : perf_fds)
+    {
+        for (int fd : fds)
+        {
+            if (fd != -1)
+            {
+                close(fd);
+            }
+        }
+    }
+#endif
+    perf_fds.clear();
+    perf_groups.clear();
+    hardware = false;
+}
+
+/**
+ * Reads the hardware events of every thread of the OpenMP team.
+ *
+ * @param[in, out] values the container to be given the sum of the events over all threads
+ *
+ * @note The counts are scaled when the kernel multiplexes the groups.
+ */
+void profiler::read_hardware(uint64_t(&values)[N_EVENTS])
+{
+    for (int i = 0; i < N_EVENTS; i += 1)
+    {
+        values[i] = 0;
+    }
+#ifdef __linux__
+    uint64_t buffer[3 + PROFILE_MAX_PERF_EVENTS];
+
+    for (auto& group : perf_groups)
+    {
+        if (read(group, buffer, sizeof(buffer)) <= 0 || buffer[2] == 0)
+        {
+            continue;
+        }
+
+        double scale = (double)buffer[1] / buffer[2];                                   /// time enabled over time running
+        for (uint64_t i = 0; i < buffer[0] && i < perf_kinds.size(); i += 1)
+        {
+            uint64_t count = (uint64_t)(buffer[3 + i] * scale);
+            if (perf_kinds[i] == -1)
+            {
+                values[EVENT_INSTRUCTIONS] += count;
+            }
+            else if (perf_kinds[i] == -2)
+            {
+                values[EVENT_CACHE_MISSES] += count;
+            }
+            else
+            {
+                values[EVENT_FLOPS] += count * perf_kinds[i];
+            }
+        }
+    }
+#endif
+}
+
+/**
+ * Names the strategy of the invocations of a kernel.
+ *
+ * @param[in] counts the invocations of the kernel run with every strategy
+ *
+ * @return the name of the only strategy used, `mixed` if the invocations used several, or `-` if none was recorded
+ */
+static std::string strategy_of(const uint64_t(&counts)[N_STRATEGIES])
+{
+    std::string name = "-";
+
+    for (int k = 0; k < N_STRATEGIES; k += 1)
+    {
+        if (counts[k] > 0)
+        {
+            name = name == "-" ? strategy_names[k] : "mixed";
+        }
+    }
+    return name;
+}
+
+/**
+ * Prints the per-phase breakdown of the counters of all threads and then resets them.
+ *
+ * @param[in] title the name of the monitored procedure (e.g. training)
+ *
+ * @note    The time stamp counter is converted to seconds using its rate since the
+ *          construction of the profiler, which is accurate on processors with an
+ *          invariant time stamp counter.
+ */
+void profiler::report(const char* title)
+{
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    double tick = seconds / (double)(ticks() - start_ticks);                             /// Seconds per tick
+    double total = 0.0;
+    std::string s(CLI_WINDOW_WIDTH + 10, '-');
+    profile_counters sum = {};
+    std::ios format(nullptr);
+
+    format.copyfmt(std::cout);                                                          /// Saves the stream's format to restore it afterwards
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        for (auto& c : counters)
+        {
+            for (int p = 0; p < N_PHASES; p += 1)
+            {
+                for (int l = 0; l < PROFILE_MAX_LAYERS; l += 1)
+                {
+                    sum.cycles[p][l] += c->cycles[p][l];
+                    sum.calls[p][l] += c->calls[p][l];
+                    total += c->cycles[p][l];
+                    for (int e = 0; e < N_EVENTS; e += 1)
+                    {
+                        sum.events[p][l][e] += c->events[p][l][e];
+                    }
+                    for (int k = 0; k < N_STRATEGIES; k += 1)
+                    {
+                        sum.strategies[p][l][k] += c->strategies[p][l][k];
+                    }
+                }
+            }
+        }
+    }
+
+    std::cout << "\n\nProfile [" << title << "]:\t\t[" << counters.size() << " thread(s)]\n" << s << std::endl;
+    std::cout << std::left << std::setw(18) << "Phase" << std::right << std::setw(6) << "Layer" << std::setw(10) << "Calls"
+              << std::setw(12) << "Time (ms)" << std::setw(8) << "Share" << std::setw(13) << "Cycles/call" << std::setw(10) << "Strategy";
+    if (hardware)
+    {
+        std::cout << std::setw(13) << "Instr/call" << std::setw(13) << "Misses/call" << std::setw(13) << "FLOP/call";
+    }
+    std::cout << "\n";
+
+    for (int p = 0; p < N_PHASES; p += 1)
+    {
+        for (int l = 0; l < PROFILE_MAX_LAYERS; l += 1)
+        {
+            uint64_t calls = sum.calls[p][l];
+            if (calls == 0)
+            {
+                continue;
+            }
+
+            std::cout << std::left << std::setw(18) << phase_names[p] << std::right << std::setw(6);
+            if (p == PHASE_FORWARD || p == PHASE_BACK_PROPAGATION || p == PHASE_OPTIMIZE)
+            {
+                std::cout << l;
+            }
+            else
+            {
+                std::cout << "-";
+            }
+            std::cout << std::setw(10) << calls << std::setw(12) << std::fixed << std::setprecision(2) << sum.cycles[p][l] * tick * 1e3
+                      << std::setw(7) << std::setprecision(1) << 100.0 * sum.cycles[p][l] / total << "%"
+                      << std::setw(13) << std::setprecision(0) << (double)sum.cycles[p][l] / calls << std::setw(10) << strategy_of(sum.strategies[p][l]);
+            if (hardware)
+            {
+                for (int e = 0; e < N_EVENTS; e += 1)
+                {
+                    std::cout << std::setw(13) << (double)sum.events[p][l][e] / calls;
+                }
+            }
+            std::cout << "\n";
+        }
+    }
+    std::cout << std::left << std::setw(34) << "Total" << std::right << std::setw(12) << std::setprecision(2) << total * tick * 1e3 << "\n";
+    std::cout.copyfmt(format);
+
+    reset();
+}
+
+/**
+ * Resets the counters of every thread.
+ */
+void profiler::reset(void)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    for (auto& c : counters)
+    {
+        *c = profile_counters();
+    }
+}
+
+profiler::~profiler()
+{
+    disable_hardware();
+    for (auto& c : counters)
+    {
+        delete c;
+    }
+}
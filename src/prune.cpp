@@ -0,0 +1,182 @@
+
+#include "neural.hpp"
+
+/**
+ * Prunes the model's synapses by magnitude, down to a target sparsity, and encodes
+ * the surviving synapses of every layer as a block-sparse matrix.
+ *
+ * @param[in] target the fraction of blocks of synapses to be pruned in every layer
+ *
+ * @note    The synapses are pruned in blocks of `PRUNE_BLOCK` neighbouring synapses of
+ *          the same neuron, ranked by the sum of their absolute values, so that the
+ *          survivors can be streamed with SIMD. The synapses of the bias and the trailing
+ *          synapses that do not fill a block are never pruned.
+ *
+ * @note    The pruned synapses are zeroed in the dense weights as well, so the dense and the
+ *          pruned kernels compute the same outputs. Training after pruning regrows them.
+ */
+void nn::prune(double target)
+{
+    if (pruned == nullptr)
+    {
+        pruned = new block_sparse[layers.size() - 1];
+    }
+
+    for (int layer = 0; layer < layers.size() - 1; layer += 1)
+    {
+        int rows = layer == layers.size() - 2 ? layers[layer + 1] : layers[layer + 1] - 1;       /// The output layer has no bias
+        int width = (layers[layer] - 1) / PRUNE_BLOCK;                                          /// Number of blocks per neuron
+        std::vector<std::pair<double, int>> ranks((size_t)rows * width);
+
+#pragma omp parallel for num_threads(threads) schedule(static)
+        for (int neuron = 0; neuron < rows; neuron += 1)                                        /// Ranks every block by magnitude
+        {
+            for (int block = 0; block < width; block += 1)
+            {
+                double magnitude = 0.0;
+                for (int k = 0; k < PRUNE_BLOCK; k += 1)
+                {
+                    magnitude += std::fabs(weights[layer][neuron][block * PRUNE_BLOCK + k]);
+                }
+                ranks[(size_t)neuron * width + block] = { magnitude, neuron * width + block };
+            }
+        }
+
+        size_t cut = (size_t)(target * ranks.size());
+        std::nth_element(ranks.begin(), ranks.begin() + cut, ranks.end());                      /// Partitions the weakest blocks to the front
+        for (size_t i = 0; i < cut; i += 1)
+        {
+            int neuron = ranks[i].second / width, block = ranks[i].second % width;
+            std::fill_n(weights[layer][neuron] + block * PRUNE_BLOCK, PRUNE_BLOCK, 0.0);
+        }
+
+        pruned[layer].compress(weights[layer], rows, layers[layer] - 1);
+    }
+}
+
+/**
+ * Feeds forward the bound input through the pruned model.
+ *
+ * @note    Each neuron streams only its surviving blocks of synapses; the trailing synapses
+ *          that do not fill a block and the synapse of the bias are read from the dense weights.
+ *          Use after `prune()`, for inference only.
+ *
+ * @note    The neurons keep uneven numbers of blocks, which a dynamic schedule balances across
+ *          the threads. The work of a layer is planned after its surviving blocks, with the dynamic
+ *          schedule picked for this kernel only: the dense kernels keep the matrix's configuration.
+ */
+void nn::forward_pruned(void)
+{
+    for (int layer = 1; layer < layers.size(); layer += 1)
+    {
+        int rows = layer == layers.size() - 1 ? layers[layer] : layers[layer] - 1;
+        block_sparse& matrix = pruned[layer - 1];
+
+        PROFILE_SCOPE(PHASE_FORWARD, layer);
+        int team = plan(layer - 1, rows, (double)matrix.blocks * PRUNE_BLOCK / rows + layers[layer - 1] - 1 - matrix.blocked, STRATEGY_DYNAMIC);
+        PROFILE_STRATEGY(PHASE_FORWARD, layer, team > 1 ? STRATEGY_DYNAMIC : STRATEGY_INLINE);
+#pragma omp parallel num_threads(team) if(team > 1)
+        {
+            TRACE_SCOPE("forward_pruned", "kernel", layer);
+#pragma omp for schedule(runtime) nowait
+            for (int neuron = 0; neuron < rows; neuron += 1)
+            {
+                double REGISTER = weights[layer - 1][neuron][layers[layer - 1] - 1];                /// Starts from the synapse of the previous layer's bias
+                for (int synapse = matrix.blocked; synapse < layers[layer - 1] - 1; synapse += 1)   /// Adds the trailing synapses
+                {
+                    REGISTER += weights[layer - 1][neuron][synapse] * a[layer - 1][synapse];
+                }
+                for (int block = matrix.offsets[neuron]; block < matrix.offsets[neuron + 1]; block += 1)
+                {
+                    const double* w = matrix.values + (size_t)block * PRUNE_BLOCK;
+                    const double* x = a[layer - 1] + matrix.starts[block];
+#pragma omp simd reduction(+ : REGISTER)
+                    for (int k = 0; k < PRUNE_BLOCK; k += 1)
+                    {
+                        REGISTER += w[k] * x[k];
+                    }
+                }
+                a[layer][neuron] = sigmoid(REGISTER);
+            }
+        }
+    }
+}
+
+/**
+ * Feeds forward every sample of a dataset, without printing anything.
+ *
+ * @param[in, out] data the dataset to be fed to the model
+ * @param[in] kernels the kernels to feed forward with: the dense, the pruned or the factorized ones
+ * @param[out] loss the average loss of the model over the dataset
+ * @param[out] validity the number of samples correctly classified
+ *
+ * @return the time elapsed, in seconds
+ */
+double nn::infer(dataset(&data), inference_kernels kernels, double& loss, int& validity)
+{
+    double start = omp_get_wtime();
+
+    loss = 0.0;
+    validity = 0;
+    for (int sample = 0; sample < data.samples; sample += 1)
+    {
+        bind_sample(data, sample, true);
+        kernels == KERNELS_FACTORED ? forward_factored() : kernels == KERNELS_PRUNED ? forward_pruned() : forward();
+        loss += mse_loss(data.Y[sample], data.classes);
+        validity += accuracy(data.Y[sample], data.classes);
+    }
+    loss /= (data.samples + 0.0);
+    return omp_get_wtime() - start;
+}
+
+/**
+ * Reports the accuracy versus latency trade-off of pruning the trained model.
+ * For every level in `PRUNE_LEVELS`, the model is pruned, the evaluation set is fed
+ * through the dense and the pruned kernels, and the accuracy, the per-sample latency of
+ * both kernels and the size of the pruned weights are printed.
+ *
+ * @param[in, out] TEST the evaluation dataset
+ *
+ * @note    The trained weights are restored afterwards, and the encodings are released.
+ *          Although passed by reference, `TEST` is not altered, other than being encoded as
+ *          sparse if its inputs are sparse enough.
+ */
+void nn::pruning_report(dataset(&TEST))
+{
+    char* trained = new char[parameter_bytes];
+    double loss, dense, sparse;
+    int validity;
+
+    snapshot(trained);
+    select_input_kernel(TEST);
+
+    std::cout << "\n\nPruning trade-off on " << TEST.samples << " samples (blocks of " << PRUNE_BLOCK << " synapses)\n";
+    std::cout << std::setw(10) << "Sparsity" << std::setw(12) << "Accuracy" << std::setw(12) << "Loss"
+              << std::setw(14) << "Dense us" << std::setw(14) << "Pruned us" << std::setw(10) << "Speedup" << std::setw(14) << "Weights KiB" << "\n";
+    for (double level : PRUNE_LEVELS)
+    {
+        size_t bytes = 0;
+
+        restore(trained);
+        prune(level);
+        dense = infer(TEST, KERNELS_DENSE, loss, validity);
+        sparse = infer(TEST, KERNELS_PRUNED, loss, validity);
+        for (int layer = 0; layer < layers.size() - 1; layer += 1)                      /// Counts the blocks, their columns and offsets, and the dense remainder
+        {
+            bytes += (size_t)pruned[layer].blocks * (PRUNE_BLOCK * sizeof(double) + sizeof(int));
+            bytes += (pruned[layer].rows + 1) * sizeof(int);
+            bytes += (size_t)pruned[layer].rows * (layers[layer] - pruned[layer].blocked) * sizeof(double);
+        }
+
+        std::cout << std::fixed << std::setprecision(2)
+                  << std::setw(9) << level * 100.0 << "%" << std::setw(11) << 100.0 * validity / TEST.samples << "%"
+                  << std::setw(12) << std::setprecision(5) << loss << std::setprecision(2)
+                  << std::setw(14) << 1e6 * dense / TEST.samples << std::setw(14) << 1e6 * sparse / TEST.samples
+                  << std::setw(9) << dense / sparse << "x" << std::setw(14) << bytes / 1024.0 << "\n";
+    }
+
+    restore(trained);
+    delete[] trained;
+    delete[] pruned;
+    pruned = nullptr;
+}
@@ -0,0 +1,248 @@
+
+#include "score.hpp"
+
+/**
+ * Loads the model and opens the streams of the scorer.
+ *
+ * @param[in] checkpoint the filepath of the model's checkpoint
+ * @param[in] input_file the filepath of the CSV file to score, or `-` for the standard input
+ * @param[in] output_file the filepath of the scores, or `-` for the standard output
+ *
+ * @note    The layout of the input is told from its first row: a row with letters is a header,
+ *          whose first column is the label if it is named so. Without a header, a row with one
+ *          more value than the model's inputs is labelled.
+ */
+void scorer::open(const char* checkpoint, const char* input_file, const char* output_file)
+{
+    char* line = nullptr;
+    size_t length = 0;
+    int inputs, outputs;
+
+    model.tune = false;
+    model.load(checkpoint);
+    inputs = model.layers[0] - 1;
+    outputs = model.layers.back();
+
+    input_filepath = input_file;
+    output_filepath = output_file;
+    input = input_filepath == "-" ? stdin : fopen(input_file, "r");
+    if (input == nullptr)
+    {
+        throw std::runtime_error("score: cannot open " + input_filepath);
+    }
+    output = output_filepath == "-" ? stdout : fopen(output_file, "w");
+    if (output == nullptr)
+    {
+        throw std::runtime_error("score: cannot open " + output_filepath);
+    }
+    setvbuf(input, nullptr, _IOFBF, SCORE_IO_BUFFER);
+    setvbuf(output, nullptr, _IOFBF, SCORE_IO_BUFFER);
+
+    if (::getline(&line, &length, input) < 0)
+    {
+        free(line);
+        throw std::runtime_error("score: empty input " + input_filepath);
+    }
+    bool header = std::any_of(line, line + strlen(line), [](char c) { return std::isalpha((unsigned char)c); });
+    columns = 1 + std::count(line, line + strlen(line), ',');
+    labelled = header ? strncmp(line, "label", 5) == 0 : columns == inputs + 1;
+    if (columns != inputs + labelled)
+    {
+        free(line);
+        throw std::runtime_error("score: the rows of " + input_filepath + " have " + std::to_string(columns) + " values, the model expects " + std::to_string(inputs));
+    }
+    if (!header)
+    {
+        pending = line;                                                                 /// The first row is a sample, to be parsed with the others
+    }
+    free(line);
+
+    batches.resize(SCORE_DEPTH);
+    for (auto& batch : batches)
+    {
+        batch.X.resize((size_t)SCORE_BATCH * inputs);
+        batch.P.resize((size_t)SCORE_BATCH * outputs);
+        batch.labels.resize(SCORE_BATCH);
+        empty.push(&batch);
+    }
+    scratch.resize((size_t)model.threads * 2 * model.hidden_width());
+
+    fprintf(output, "prediction");
+    for (int neuron = 0; neuron < outputs; neuron += 1)
+    {
+        fprintf(output, ",p%d", neuron);
+    }
+    fprintf(output, "\n");
+}
+
+/**
+ * Parses a row of the input into the next slot of a batch.
+ *
+ * @param[in, out] line the row, which is not kept
+ * @param[in, out] batch the batch to be given the row
+ *
+ * @return `false` if the row does not have the expected number of values
+ */
+bool scorer::parse_row(char* line, score_batch& batch)
+{
+    double* x = batch.X.data() + (size_t)batch.rows * (model.layers[0] - 1);
+
+    if (!parse_sample(line, columns, labelled, x, batch.labels[batch.rows]))
+    {
+        return false;
+    }
+    batch.rows += 1;
+    return true;
+}
+
+/**
+ * Implements the parser stage: fills empty batches with the rows of the input, until the input ends.
+ */
+void scorer::parse(void)
+{
+    char* line = nullptr;
+    size_t length = 0;
+    score_batch* batch;
+    bool more = true;
+
+    while (more && empty.pop(batch))
+    {
+        double start = omp_get_wtime();
+        batch->rows = 0;
+        if (!pending.empty())
+        {
+            malformed += !parse_row(&pending[0], *batch);
+            pending.clear();
+        }
+        while (batch->rows < SCORE_BATCH)
+        {
+            if (::getline(&line, &length, input) < 0)
+            {
+                more = false;
+                break;
+            }
+            malformed += !parse_row(line, *batch);
+        }
+        parse_time += omp_get_wtime() - start;
+        if (batch->rows == 0)
+        {
+            empty.push(batch);
+            break;
+        }
+        parsed.push(batch);
+    }
+    free(line);
+    parsed.close();
+}
+
+/**
+ * Implements the writer stage: writes the predicted label and the probabilities of every row of
+ * the scored batches, and returns the batches to the parser.
+ */
+void scorer::write(void)
+{
+    int outputs = model.layers.back();
+    score_batch* batch;
+    char field[32];
+
+    while (scored.pop(batch))
+    {
+        double start = omp_get_wtime();
+        for (int row = 0; row < batch->rows; row += 1)
+        {
+            const double* p = batch->P.data() + (size_t)row * outputs;
+            int label = std::max_element(p, p + outputs) - p;
+            correct += label == batch->labels[row];
+            fputs(std::to_string(label).c_str(), output);
+            for (int neuron = 0; neuron < outputs; neuron += 1)
+            {
+                int n = snprintf(field, sizeof(field), ",%.6f", p[neuron]);
+                fwrite(field, 1, n, output);
+            }
+            fputc('\n', output);
+        }
+        rows += batch->rows;
+        write_time += omp_get_wtime() - start;
+        empty.push(batch);
+    }
+    fflush(output);
+}
+
+/**
+ * Streams the input through the three stages of the scorer.
+ */
+void scorer::run(void)
+{
+    double start = omp_get_wtime();
+    std::thread parser([this]() { parse(); });
+    std::thread writer([this]() { write(); });
+    score_batch* batch;
+
+    while (parsed.pop(batch))
+    {
+        double begin = omp_get_wtime();
+        model.forward_batch(batch->X.data(), batch->rows, batch->P.data(), scratch.data());
+        forward_time += omp_get_wtime() - begin;
+        scored.push(batch);
+    }
+    scored.close();
+    parser.join();
+    writer.join();
+    seconds = omp_get_wtime() - start;
+}
+
+/**
+ * Prints the throughput of the scorer, and the time every stage was busy for. The report goes to
+ * the standard error if the scores go to the standard output.
+ */
+void scorer::report(void)
+{
+    std::ostream& stream = output == stdout ? std::cerr : std::cout;
+    std::ios state(nullptr);
+
+    state.copyfmt(stream);
+    stream << "\n[SCORE] [ROWS " << rows << "] [MALFORMED " << malformed << "] ";
+    if (labelled)
+    {
+        stream << "[ACCURACY " << correct << " out of " << rows << "] ";
+    }
+    stream << std::fixed << std::setprecision(0) << "[ROWS/S " << rows / std::max(seconds, 1e-9) << "] " << std::setprecision(3)
+           << "Scored in " << seconds << " seconds (busy: parse " << parse_time << ", forward " << forward_time << ", write "
+           << write_time << ") into " << output_filepath << "\n";
+    stream.copyfmt(state);
+}
+
+/**
+ * Parses a row of a CSV file laid out like the training files.
+ *
+ * @param[in, out] line the row, which is not kept
+ * @param[in] columns the number of values of the row
+ * @param[in] labelled `true` if the first value is the label of the row
+ * @param[out] x the inputs of the row (`columns - labelled` values), normalized like the training files
+ * @param[out] label the label of the row, or -1 if it is not labelled
+ *
+ * @return `false` if the row does not have the expected number of values
+ */
+bool parse_sample(char* line, int columns, bool labelled, double* x, int& label)
+{
+    char* cursor = line, * end;
+
+    label = -1;
+    for (int column = 0; column < columns; column += 1)
+    {
+        long value = strtol(cursor, &end, 10);
+        bool last = column == columns - 1;
+        if (end == cursor || (!last && *end != ',') || (last && *end == ','))
+        {
+            return false;
+        }
+        cursor = end + 1;
+        if (labelled && column == 0)
+        {
+            label = (int)value;
+            continue;
+        }
+        x[column - labelled] = (value + 0.0) / MNIST_MAX_VAL;                          /// Normalizes the row like the training CSV files
+    }
+    return true;
+}
@@ -0,0 +1,64 @@
+
+#include "selective.hpp"
+
+/**
+ * Decides whether the backward pass of a sample is kept, from the loss of its forward pass.
+ *
+ * @param[in] loss the loss of the sample's forward pass
+ * @param[in, out] gen the random generator of the training
+ *
+ * @return the weight of the sample's backward pass: 0 (zero) if it is skipped, otherwise the
+ *         inverse of the probability it was kept with
+ *
+ * @note    Importance sampling in proportion to the norm of the gradient keeps the variance of the
+ *          weighted steps low: a kept pass steps by about as much as any pass of a fitted sample.
+ */
+double selective_sampler::weigh(double loss, std::mt19937& gen)
+{
+    double probability = std::min(1.0, std::max(floor, std::sqrt(loss / SELECTIVE_LOSS)));
+
+    seen += 1;
+    if (probability < 1.0 && std::uniform_real_distribution<>(0.0, 1.0)(gen) >= probability)
+    {
+        return 0.0;
+    }
+    kept += 1;
+    weights += 1.0 / probability;
+    return 1.0 / probability;
+}
+
+/**
+ * Closes the counters of an epoch.
+ */
+void selective_sampler::end_epoch(void)
+{
+    epoch_seen.push_back(seen);
+    epoch_kept.push_back(kept);
+    epoch_weights.push_back(weights);
+    seen = kept = 0;
+    weights = 0.0;
+}
+
+/**
+ * Prints the backward passes kept and saved in every epoch, and the average weight of the kept passes.
+ */
+void selective_sampler::report(void)
+{
+    std::ios state(nullptr);
+    long total_seen = 0, total_kept = 0;
+
+    state.copyfmt(std::cout);
+    std::cout << "\n\nSelective backward passes (floor " << std::fixed << std::setprecision(2) << floor << ", loss " << SELECTIVE_LOSS << ")\n"
+              << std::setw(8) << "Epoch" << std::setw(12) << "Forward" << std::setw(12) << "Backward" << std::setw(10) << "Saved" << std::setw(10) << "Weight" << "\n";
+    for (int epoch = 0; epoch < epoch_seen.size(); epoch += 1)
+    {
+        std::cout << std::setw(8) << epoch + 1 << std::setw(12) << epoch_seen[epoch] << std::setw(12) << epoch_kept[epoch]
+                  << std::setw(9) << 100.0 * (epoch_seen[epoch] - epoch_kept[epoch]) / std::max(epoch_seen[epoch], 1L) << "%"
+                  << std::setw(10) << epoch_weights[epoch] / std::max(epoch_kept[epoch], 1L) << "\n";
+        total_seen += epoch_seen[epoch];
+        total_kept += epoch_kept[epoch];
+    }
+    std::cout << "\n[SELECTIVE] [KEPT " << total_kept << " of " << total_seen << "] " << std::setprecision(1)
+              << 100.0 * (total_seen - total_kept) / std::max(total_seen, 1L) << "% of the backward passes saved\n";
+    std::cout.copyfmt(state);
+}
@@ -0,0 +1,71 @@
+
+#include "sparse.hpp"
+
+/**
+ * Encodes the non-zero blocks of a dense matrix.
+ *
+ * @param[in] dense the dense matrix, one pointer per row
+ * @param[in] rows the number of rows to encode
+ * @param[in] columns the number of columns to encode
+ *
+ * @note    A block is kept if any of its values is non-zero. The trailing
+ *          `columns % PRUNE_BLOCK` columns are left to the dense matrix.
+ */
+void block_sparse::compress(double** dense, int rows, int columns)
+{
+    release();
+    this->rows = rows;
+    blocked = columns - columns % PRUNE_BLOCK;
+
+    offsets = new int[rows + 1];
+    offsets[0] = 0;
+    for (int i = 0; i < rows; i += 1)                                                   /// Counts the non-zero blocks of every row
+    {
+        int count = 0;
+        for (int j = 0; j < blocked; j += PRUNE_BLOCK)
+        {
+            bool zero = true;
+            for (int k = 0; k < PRUNE_BLOCK; k += 1)
+            {
+                zero = zero && dense[i][j + k] == 0.0;
+            }
+            count += !zero;
+        }
+        offsets[i + 1] = offsets[i] + count;
+    }
+
+    blocks = offsets[rows];
+    starts = new int[blocks];
+    values = new double[(size_t)blocks * PRUNE_BLOCK];
+    for (int i = 0; i < rows; i += 1)                                                   /// Copies the non-zero blocks
+    {
+        int b = offsets[i];
+        for (int j = 0; j < blocked; j += PRUNE_BLOCK)
+        {
+            bool zero = true;
+            for (int k = 0; k < PRUNE_BLOCK; k += 1)
+            {
+                zero = zero && dense[i][j + k] == 0.0;
+            }
+            if (!zero)
+            {
+                starts[b] = j;
+                std::copy_n(dense[i] + j, PRUNE_BLOCK, values + (size_t)b * PRUNE_BLOCK);
+                b += 1;
+            }
+        }
+    }
+}
+
+/**
+ * Releases the encoding.
+ */
+void block_sparse::release(void)
+{
+    delete[] offsets;
+    delete[] starts;
+    delete[] values;
+    offsets = starts = nullptr;
+    values = nullptr;
+    rows = blocked = blocks = 0;
+}
@@ -0,0 +1,234 @@
+
+#include "sweep.hpp"
+
+/**
+ * Splits a string on a delimiter.
+ *
+ * @param[in] text the string to split
+ * @param[in] delimiter the character that separates the fields
+ *
+ * @return the fields of the string, in order
+ */
+static std::vector<std::string> split(const std::string& text, char delimiter)
+{
+    std::vector<std::string> fields;
+    std::stringstream stream(text);
+    std::string field;
+
+    while (std::getline(stream, field, delimiter))
+    {
+        fields.push_back(field);
+    }
+    return fields;
+}
+
+/**
+ * Loads the trials of the sweep from a configuration file.
+ *
+ * @param[in] filename the filepath of the configuration file
+ *
+ * @note    A line such as `100,50|150 0.1|0.05 10` expands to four trials. Every trial
+ *          needs at least one hidden layer, just like the models of the driver.
+ */
+void sweep::load(const char* filename)
+{
+    std::ifstream stream(filename);
+    std::string line;
+
+    if (!stream)
+    {
+        throw std::runtime_error(std::string("sweep: cannot open ") + filename);
+    }
+
+    while (std::getline(stream, line))
+    {
+        std::stringstream fields(line);
+        std::string layers, rates, epochs;
+
+        if (!(fields >> layers >> rates >> epochs) || layers[0] == '#')                 /// Skips comments and blank lines
+        {
+            continue;
+        }
+
+        for (auto& l : split(layers, '|'))                                              /// Expands the grid of the line
+        {
+            std::vector<int> hidden;
+            for (auto& width : split(l, ','))
+            {
+                hidden.push_back(std::stoi(width));
+            }
+            for (auto& r : split(rates, '|'))
+            {
+                for (auto& e : split(epochs, '|'))
+                {
+                    trials.emplace_back(hidden, std::stod(r), std::stoi(e));
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Trains the surviving trials concurrently up to a budget of epochs, and then evaluates them.
+ *
+ * @param[in, out] TRAIN the training dataset, shared by all trials
+ * @param[in, out] TEST the evaluation dataset, shared by all trials
+ * @param[in] survivors the indices of the trials that take part in the rung
+ * @param[in] budget the number of epochs every trial is trained up to (capped by its own epochs)
+ *
+ * @note    As many trials as there are threads run at once, and the threads of the host are split
+ *          evenly among them. The kernels of a trial run as a nested parallel region inside the
+ *          region of the trials. As trials are cut, the remaining ones are given more threads.
+ *
+ * @note    The datasets have to be encoded as sparse beforehand, if they are sparse enough, so that
+ *          the trials only ever read them.
+ */
+void sweep::train_rung(dataset(&TRAIN), dataset(&TEST), std::vector<int>& survivors, int budget)
+{
+    int concurrency = std::min((int)survivors.size(), host.threads);
+    int share = std::max(1, host.threads / concurrency);                                /// Threads given to every trial
+
+#pragma omp parallel for num_threads(concurrency) schedule(dynamic, 1)
+    for (int i = 0; i < survivors.size(); i += 1)
+    {
+        TRACE_SCOPE("trial", "sweep", survivors[i]);
+        trial& t = trials[survivors[i]];
+        double loss;
+        int validity;
+
+        if (t.model == nullptr)                                                         /// Compiles the trial's model on its first rung
+        {
+            std::vector<int> l = { TRAIN.dimensions + 1 };
+            for (auto& width : t.hidden)
+            {
+                l.push_back(width + 1);
+            }
+            l.push_back(TRAIN.classes);
+
+            t.model = new nn;
+            t.model->learning_rate = t.learning_rate;
+            t.model->epochs = t.epochs;
+            t.model->threads = share;
+            t.model->tune = false;                                                      /// Concurrent trials would disturb each other's measurements
+            t.model->compile(l, -1.0, 1.0);
+        }
+        t.model->threads = share;
+        t.model->tuning.assign(t.model->tuning.size(), kernel_config(share, 1));
+
+        t.model->select_input_kernel(TRAIN);
+        for (; t.trained < std::min(budget, t.epochs); t.trained += 1)
+        {
+            t.seconds += t.model->train_epoch(TRAIN, t.gen, loss, validity);
+        }
+
+        t.model->select_input_kernel(TEST);
+        t.model->infer(TEST, KERNELS_DENSE, t.loss, t.validity);
+        t.rung += 1;
+        if (t.validity > t.best)
+        {
+            t.best = t.validity;
+            t.seconds_to_best = t.seconds;
+        }
+    }
+}
+
+/**
+ * Runs the sweep with successive halving. Every rung trains the surviving trials up to
+ * a budget of epochs, ranks them by their evaluation accuracy, and keeps the best
+ * `1 / SWEEP_ETA` of them. The budget is multiplied by `SWEEP_ETA` at every rung. Trials
+ * that reach their own epochs are complete and leave the sweep.
+ *
+ * @param[in, out] TRAIN the training dataset, shared by all trials
+ * @param[in, out] TEST the evaluation dataset, shared by all trials
+ *
+ * @note    The models of the trials that leave the sweep are released right away.
+ */
+void sweep::run(dataset(&TRAIN), dataset(&TEST))
+{
+    std::random_device rd;
+    std::vector<int> survivors;
+
+    for (int i = 0; i < trials.size(); i += 1)
+    {
+        trials[i].gen.seed(rd());
+        survivors.push_back(i);
+    }
+
+    if (TRAIN.density < SPARSE_DENSITY)                                                 /// Encodes the shared datasets once, before they are shared
+    {
+        TRAIN.encode_sparse();
+    }
+    if (TEST.density < SPARSE_DENSITY)
+    {
+        TEST.encode_sparse();
+    }
+    omp_set_max_active_levels(2);                                                       /// Lets the kernels of a trial run in parallel inside the region of the trials
+
+    for (int budget = SWEEP_MIN_EPOCHS, rung = 1; !survivors.empty(); budget *= SWEEP_ETA, rung += 1)
+    {
+        double start = omp_get_wtime();
+        int concurrency = std::min((int)survivors.size(), host.threads);
+
+        train_rung(TRAIN, TEST, survivors, budget);
+        std::cout << "\n[RUNG " << std::setw(3) << rung << "] [TRIALS " << std::setw(4) << survivors.size() << "] [EPOCHS "
+                  << std::setw(4) << budget << "] [THREADS PER TRIAL " << std::setw(3) << std::max(1, host.threads / concurrency)
+                  << "] Work took " << std::fixed << std::setw(8) << std::setprecision(3) << omp_get_wtime() - start << " seconds";
+
+        std::stable_sort(survivors.begin(), survivors.end(), [this](int x, int y) { return trials[x].validity > trials[y].validity; });
+        int keep = (survivors.size() + SWEEP_ETA - 1) / SWEEP_ETA;                      /// Keeps the best of the rung (at least one)
+        for (int i = 0; i < survivors.size(); i += 1)
+        {
+            trial& t = trials[survivors[i]];
+            t.alive = i < keep;
+            if (!t.alive || t.trained == t.epochs)                                      /// Releases the trials that are cut or complete
+            {
+                delete t.model;
+                t.model = nullptr;
+            }
+        }
+        survivors.resize(keep);
+        survivors.erase(std::remove_if(survivors.begin(), survivors.end(), [this](int i) { return trials[i].model == nullptr; }), survivors.end());
+    }
+    std::cout << "\n";
+}
+
+/**
+ * Prints the trials of the sweep, ranked by their best evaluation accuracy and then by
+ * the training time it took them to reach it.
+ *
+ * @param[in] samples the number of evaluation samples
+ */
+void sweep::report(int samples)
+{
+    std::vector<int> ranks(trials.size());
+
+    for (int i = 0; i < ranks.size(); i += 1)
+    {
+        ranks[i] = i;
+    }
+    std::stable_sort(ranks.begin(), ranks.end(), [this](int x, int y) {
+        return trials[x].best != trials[y].best ? trials[x].best > trials[y].best : trials[x].seconds_to_best < trials[y].seconds_to_best;
+    });
+
+    std::cout << "\nSweep results (" << trials.size() << " trials, successive halving by " << SWEEP_ETA << ")\n";
+    std::cout << std::setw(6) << "Rank" << std::setw(20) << "Hidden" << std::setw(10) << "LR" << std::setw(10) << "Epochs"
+              << std::setw(12) << "Accuracy" << std::setw(10) << "Loss" << std::setw(12) << "Train s" << std::setw(12) << "To best s"
+              << "   Status\n";
+    for (int r = 0; r < ranks.size(); r += 1)
+    {
+        trial& t = trials[ranks[r]];
+        std::string hidden;
+
+        for (auto& width : t.hidden)
+        {
+            hidden += (hidden.empty() ? "" : ",") + std::to_string(width);
+        }
+        std::cout << std::fixed << std::setw(6) << r + 1 << std::setw(20) << hidden
+                  << std::setw(10) << std::setprecision(4) << t.learning_rate
+                  << std::setw(5) << t.trained << "/" << std::left << std::setw(4) << t.epochs << std::right
+                  << std::setw(11) << std::setprecision(2) << 100.0 * t.best / samples << "%"
+                  << std::setw(10) << std::setprecision(5) << t.loss
+                  << std::setw(12) << std::setprecision(3) << t.seconds << std::setw(12) << t.seconds_to_best
+                  << "   " << (t.trained == t.epochs ? "complete" : "cut after rung " + std::to_string(t.rung)) << "\n";
+    }
+}
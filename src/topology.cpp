@@ -0,0 +1,274 @@
+
+#include "topology.hpp"
+
+topology host;
+
+/**
+ * Parses a Linux CPU list (e.g. `0-3,8-11`) into its logical processors.
+ *
+ * @param[in] list the null terminated CPU list
+ * @param[in, out] vec the container to be given the logical processors
+ */
+static void parse_cpulist(const char* list, std::vector<int>& vec)
+{
+    while (*list != '\0' && *list != '\n')
+    {
+        char* end;
+        int first = (int)strtol(list, &end, 10);
+        int last = first;
+
+        if (end == list)                                                            /// Masks malformed list
+        {
+            break;
+        }
+        if (*end == '-')
+        {
+            list = end + 1;
+            last = (int)strtol(list, &end, 10);
+        }
+        for (int cpu = first; cpu <= last; cpu += 1)
+        {
+            vec.push_back(cpu);
+        }
+        list = (*end == ',') ? end + 1 : end;
+    }
+}
+
+/**
+ * Maps every logical processor to its NUMA node using the Linux sysfs.
+ *
+ * @param[in] cpus the logical processors available to the process
+ * @param[in, out] cpu_node the container to be given the node of each logical processor
+ * @param[in, out] nodes the number of NUMA nodes found
+ *
+ * @note    On hosts without NUMA information (or non Linux hosts), every
+ *          logical processor is considered to belong to node 0 (zero).
+ */
+static void detect_nodes(std::vector<int>& cpus, std::vector<int>& cpu_node, int& nodes)
+{
+    cpu_node.assign(cpus.size(), 0);
+    nodes = 1;
+#ifdef __linux__
+    for (int node = 0; ; node += 1)
+    {
+        char path[128], list[4096];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+
+        FILE* stream = fopen(path, "r");
+        if (!stream)
+        {
+            break;
+        }
+        if (fgets(list, sizeof(list), stream) != NULL)
+        {
+            std::vector<int> node_cpus;
+            parse_cpulist(list, node_cpus);
+            for (int i = 0; i < cpus.size(); i += 1)
+            {
+                if (std::find(node_cpus.begin(), node_cpus.end(), cpus[i]) != node_cpus.end())
+                {
+                    cpu_node[i] = node;
+                }
+            }
+        }
+        fclose(stream);
+        nodes = node + 1;
+    }
+#endif
+}
+
+/**
+ * Detects the logical processors available to the process and the NUMA node
+ * of each one of them. Then, it assigns a logical processor to every thread
+ * based on the chosen affinity policy.
+ */
+void topology::detect(void)
+{
+    cpus.clear();
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)                               /// Respects `taskset` and cgroup restrictions
+    {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu += 1)
+        {
+            if (CPU_ISSET(cpu, &set))
+            {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+#endif
+    if (cpus.empty())
+    {
+        for (int cpu = 0; cpu < omp_get_num_procs(); cpu += 1)
+        {
+            cpus.push_back(cpu);
+        }
+    }
+
+    detect_nodes(cpus, cpu_node, nodes);
+
+    if (threads <= 0)                                                               /// Uses `OMP_NUM_THREADS` or the number of logical processors
+    {
+        threads = omp_get_max_threads();
+    }
+
+    std::vector<int> order(cpus.size());                                            /// Indices of `cpus` in the order threads are going to be assigned
+    for (int i = 0; i < order.size(); i += 1)
+    {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](int x, int y) { return cpu_node[x] < cpu_node[y]; });
+
+    if (policy == AFFINITY_SCATTER)                                                 /// Deals one logical processor per node at a time
+    {
+        std::vector<std::vector<int>> per_node(nodes);
+        for (auto& i : order)
+        {
+            per_node[cpu_node[i]].push_back(i);
+        }
+        order.clear();
+        for (int round = 0; order.size() < cpus.size(); round += 1)
+        {
+            for (auto& node_cpus : per_node)
+            {
+                if (round < node_cpus.size())
+                {
+                    order.push_back(node_cpus[round]);
+                }
+            }
+        }
+    }
+
+    thread_cpu.resize(threads);
+    for (int thread = 0; thread < threads; thread += 1)                             /// Oversubscribed threads wrap around the available processors
+    {
+        thread_cpu[thread] = cpus[order[thread % order.size()]];
+    }
+}
+
+/**
+ * Pins every thread of the OpenMP team to the logical processor assigned to it.
+ *
+ * @note    The OpenMP runtime reuses the same team for every parallel region with
+ *          the same number of threads, therefore the binding persists throughout
+ *          the execution. The master thread is pinned too, which means that the
+ *          data it parses are placed on the node of the first thread.
+ */
+void topology::bind(void)
+{
+    omp_set_num_threads(threads);
+    if (policy == AFFINITY_NONE)
+    {
+        return;
+    }
+#ifdef __linux__
+#pragma omp parallel num_threads(threads)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(thread_cpu[omp_get_thread_num()], &set);
+        sched_setaffinity(0, sizeof(set), &set);
+    }
+#endif
+}
+
+/**
+ * Fetches the NUMA node a thread is going to run on.
+ *
+ * @param[in] thread the OpenMP thread number
+ *
+ * @return the NUMA node of the thread's logical processor
+ */
+int topology::thread_node(int thread)
+{
+    int cpu = thread_cpu[thread % thread_cpu.size()];
+
+    for (int i = 0; i < cpus.size(); i += 1)
+    {
+        if (cpus[i] == cpu)
+        {
+            return cpu_node[i];
+        }
+    }
+    return 0;
+}
+
+/**
+ * Queries the NUMA node a page of memory resides on.
+ *
+ * @param[in] addr an address in the page to query
+ *
+ * @return the node of the page, or -1 if the page has not been touched yet or the query is not supported
+ */
+int topology::page_node(const void* addr)
+{
+#if defined(__linux__) && defined(SYS_move_pages)
+    static const long page_size = sysconf(_SC_PAGESIZE);
+    void* page = (void*)((uintptr_t)addr & ~(uintptr_t)(page_size - 1));
+    int status = -1;
+
+    if (syscall(SYS_move_pages, 0, 1UL, &page, NULL, &status, 0) == 0 && status >= 0)
+    {
+        return status;
+    }
+#endif
+    return nodes == 1 ? 0 : -1;
+}
+
+/**
+ * Computes the number of bytes of a buffer that reside on a node other than the given one.
+ *
+ * @param[in] addr the first byte of the buffer
+ * @param[in] bytes the size of the buffer
+ * @param[in] node the node that consumes the buffer
+ *
+ * @return the number of the buffer's bytes found on a remote node
+ */
+double topology::remote_bytes(const void* addr, size_t bytes, int node)
+{
+#ifdef __linux__
+    static const long page_size = sysconf(_SC_PAGESIZE);
+#else
+    static const long page_size = 4096;
+#endif
+    double remote = 0.0;
+
+    if (nodes == 1)
+    {
+        return remote;
+    }
+
+    uintptr_t begin = (uintptr_t)addr, end = begin + bytes;
+    while (begin < end)                                                             /// Walks the buffer one page at a time
+    {
+        uintptr_t page_end = (begin & ~(uintptr_t)(page_size - 1)) + page_size;
+        uintptr_t chunk_end = page_end < end ? page_end : end;
+        int page = page_node((const void*)begin);
+        if (page >= 0 && page != node)
+        {
+            remote += (double)(chunk_end - begin);
+        }
+        begin = chunk_end;
+    }
+    return remote;
+}
+
+/**
+ * Fetches the name of the affinity policy in use.
+ *
+ * @return a string literal with the policy's name
+ */
+const char* topology::policy_name(void)
+{
+    switch (policy)
+    {
+    case AFFINITY_COMPACT:
+        return "compact";
+    case AFFINITY_SCATTER:
+        return "scatter";
+    default:
+        return "none";
+    }
+}
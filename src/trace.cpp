@@ -0,0 +1,107 @@
+
+#include "trace.hpp"
+
+tracer timeline;
+
+/**
+ * Fetches the ring buffer of the calling thread. On the first call of a thread,
+ * the buffer is allocated and pushed onto the tracer's list with a CAS loop.
+ *
+ * @return the ring buffer private to the calling thread
+ */
+trace_buffer& tracer::local(void)
+{
+    static thread_local trace_buffer* mine = nullptr;
+
+    if (mine == nullptr)
+    {
+        mine = new trace_buffer(registered.fetch_add(1), omp_get_thread_num());
+        trace_buffer* first = buffers.load(std::memory_order_relaxed);
+        do
+        {
+            mine->next = first;
+        } while (!buffers.compare_exchange_weak(first, mine, std::memory_order_release, std::memory_order_relaxed));
+    }
+    return *mine;
+}
+
+/**
+ * Records a complete event into the calling thread's ring buffer.
+ *
+ * @param[in] name the name of the region (must outlive the tracer)
+ * @param[in] category the category of the region (must outlive the tracer)
+ * @param[in] arg an integer attached to the event (e.g. the layer), or -1
+ * @param[in] begin the timestamp of the region's begin
+ * @param[in] end the timestamp of the region's end
+ */
+void tracer::record(const char* name, const char* category, int arg, uint64_t begin, uint64_t end)
+{
+    trace_buffer& buffer = local();
+    uint64_t slot = buffer.head.load(std::memory_order_relaxed);
+
+    buffer.events[slot & (TRACE_BUFFER_EVENTS - 1)] = { name, category, arg, begin, end };
+    buffer.head.store(slot + 1, std::memory_order_release);                         /// Publishes the event to the exporter
+}
+
+/**
+ * Exports the events of all threads as a Chrome trace-event JSON document.
+ *
+ * @param[in] filename the file path of the JSON document
+ *
+ * @note Timestamps are exported in microseconds since the construction of the tracer.
+ */
+void tracer::export_timeline(const char* filename)
+{
+    std::ofstream stream(filename);
+    uint64_t start = origin.time_since_epoch().count();
+    bool first = true;
+
+    stream << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n";
+    stream << std::fixed << std::setprecision(3);
+    for (trace_buffer* buffer = buffers.load(std::memory_order_acquire); buffer != nullptr; buffer = buffer->next)
+    {
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t tail = head > TRACE_BUFFER_EVENTS ? head - TRACE_BUFFER_EVENTS : 0;  /// The oldest events have been overwritten
+
+        stream << (first ? "" : ",\n") << "{\"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer->tid
+               << ", \"name\": \"thread_name\", \"args\": {\"name\": \"thread " << buffer->tid << " (omp " << buffer->omp_tid << ")\"}}";
+        first = false;
+
+        for (uint64_t i = tail; i < head; i += 1)
+        {
+            trace_event& e = buffer->events[i & (TRACE_BUFFER_EVENTS - 1)];
+            stream << ",\n{\"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->tid << ", \"name\": \"" << e.name
+                   << "\", \"cat\": \"" << e.category << "\", \"ts\": " << (e.begin - start) * 1e-3
+                   << ", \"dur\": " << (e.end - e.begin) * 1e-3;
+            if (e.arg >= 0)
+            {
+                stream << ", \"args\": {\"layer\": " << e.arg << "}";
+            }
+            stream << "}";
+        }
+    }
+    stream << "\n]}\n";
+}
+
+/**
+ * Writes the timeline, if any event was recorded, and releases the buffers.
+ */
+tracer::~tracer()
+{
+    trace_buffer* buffer = buffers.load(std::memory_order_acquire);
+
+    if (buffer != nullptr)
+    {
+        const char* filename = getenv("NN_TRACE");
+        filename = filename != NULL ? filename : TRACE_DEFAULT_FILEPATH;
+        export_timeline(filename);
+        std::cout << "\nTimeline exported to " << filename << "\n";
+    }
+
+    while (buffer != nullptr)
+    {
+        trace_buffer* next = buffer->next;
+        delete buffer;
+        buffer = next;
+    }
+}
@@ -0,0 +1,297 @@
+
+#include "neural.hpp"
+
+#include <sstream>                                  /// std::istringstream
+
+/**
+ * Reads the processor model of the host.
+ *
+ * @return the model name reported by the kernel, or `unknown` if it cannot be read
+ */
+std::string cpu_model(void)
+{
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+
+    while (std::getline(cpuinfo, line))
+    {
+        if (line.rfind("model name", 0) == 0 && line.find(':') != std::string::npos)
+        {
+            return line.substr(line.find_first_not_of(" \t", line.find(':') + 1));
+        }
+    }
+    return "unknown";
+}
+
+/**
+ * Builds the key of an entry of the cache.
+ *
+ * @param[in] threads the number of threads the model was given
+ * @param[in] rows the number of neurons of a weight matrix
+ * @param[in] columns the number of synapses of every neuron
+ *
+ * @return the key of the entry on this host
+ */
+std::string tuning_cache::key(int threads, int rows, int columns)
+{
+    return cpu + "\t" + std::to_string(threads) + "\t" + std::to_string(rows) + "\t" + std::to_string(columns);
+}
+
+/**
+ * Loads the cache from its file. A missing file is an empty cache.
+ */
+void tuning_cache::load(void)
+{
+    std::ifstream stream(filepath);
+    std::string line;
+
+    cpu = cpu_model();
+    entries.clear();
+    while (std::getline(stream, line))
+    {
+        std::istringstream fields(line);
+        std::string name, threads, rows, columns;
+        kernel_config config;
+        int strategy;
+
+        if (std::getline(fields, name, '\t') && std::getline(fields, threads, '\t') && std::getline(fields, rows, '\t')
+            && std::getline(fields, columns, '\t') && (fields >> config.threads >> config.grain))
+        {
+            config.strategy = (fields >> strategy) && strategy > STRATEGY_INLINE && strategy < N_STRATEGIES ? (kernel_strategy)strategy : STRATEGY_STATIC;
+            entries[name + "\t" + threads + "\t" + rows + "\t" + columns] = config;
+        }
+    }
+}
+
+/**
+ * Looks up the tuned configuration of a weight matrix on this host.
+ *
+ * @param[in] threads the number of threads the model was given
+ * @param[in] rows the number of neurons of the matrix
+ * @param[in] columns the number of synapses of every neuron
+ * @param[out] config the tuned configuration, if found
+ *
+ * @return `true` if the matrix has been tuned before
+ */
+bool tuning_cache::find(int threads, int rows, int columns, kernel_config& config)
+{
+    auto entry = entries.find(key(threads, rows, columns));
+
+    if (entry == entries.end() || entry->second.threads > threads)
+    {
+        return false;
+    }
+    config = entry->second;
+    return true;
+}
+
+/**
+ * Stores the tuned configuration of a weight matrix on this host.
+ *
+ * @param[in] threads the number of threads the model was given
+ * @param[in] rows the number of neurons of the matrix
+ * @param[in] columns the number of synapses of every neuron
+ * @param[in] config the tuned configuration
+ */
+void tuning_cache::store(int threads, int rows, int columns, const kernel_config& config)
+{
+    entries[key(threads, rows, columns)] = config;
+}
+
+/**
+ * Writes the cache to its file. The cache is written to a temporary file that is then
+ * renamed over the previous one, so a concurrent run never reads half a cache.
+ */
+void tuning_cache::save(void)
+{
+    std::string temporary = filepath + ".tmp";
+    std::ofstream stream(temporary);
+
+    for (auto& entry : entries)
+    {
+        stream << entry.first << "\t" << entry.second.threads << "\t" << entry.second.grain << "\t" << entry.second.strategy << "\n";
+    }
+    stream.close();
+    if (!stream || std::rename(temporary.c_str(), filepath.c_str()) != 0)
+    {
+        std::cerr << "tuner: could not write " << filepath << "\n";
+    }
+}
+
+/**
+ * Plans an invocation of a kernel over a weight matrix: picks its threads after the work it is
+ * given, and sets the schedule of its `schedule(runtime)` loop.
+ *
+ * @param[in] matrix the index of the weight matrix
+ * @param[in] n the number of iterations of the loop
+ * @param[in] cost the multiply-adds of an iteration
+ *
+ * @return the number of threads of the invocation (1 runs the kernel inline, on the calling thread)
+ *
+ * @note    Every thread is given at least `PARALLEL_MIN_WORK` multiply-adds, up to the threads of the
+ *          matrix's configuration, so a small kernel, such as the output layer's, runs on the calling
+ *          thread instead of waking the team up. A dynamic schedule hands out chunks of about
+ *          `DYNAMIC_CHUNK_WORK` multiply-adds, and a static one `grain` chunks per thread.
+ *
+ * @note    The work is estimated for every invocation, so the sparse input of the first layer (whose
+ *          cost is the number of its non-zero inputs) is planned sample by sample.
+ */
+int nn::plan(int matrix, int n, double cost)
+{
+    return plan(matrix, n, cost, tuning[matrix].strategy);
+}
+
+/**
+ * Plans an invocation of a kernel over a weight matrix with the given schedule, rather than
+ * the one of the matrix's configuration.
+ *
+ * @param[in] matrix the index of the weight matrix
+ * @param[in] n the number of iterations of the loop
+ * @param[in] cost the multiply-adds of an iteration
+ * @param[in] scheduling the schedule of the loop: `STRATEGY_STATIC` or `STRATEGY_DYNAMIC`
+ *
+ * @return the number of threads of the invocation (1 runs the kernel inline, on the calling thread)
+ *
+ * @note    For kernels whose iterations are uneven, such as the pruned ones. The configuration of
+ *          the matrix is left untouched, so its other kernels keep their schedule.
+ */
+int nn::plan(int matrix, int n, double cost, kernel_strategy scheduling)
+{
+    const kernel_config& config = tuning[matrix];
+    double work = n * cost;
+    int team = (int)std::max(1.0, std::min({ (double)config.threads, (double)n, work / PARALLEL_MIN_WORK }));
+
+    if (team > 1 && scheduling == STRATEGY_DYNAMIC)
+    {
+        omp_set_schedule(omp_sched_dynamic, (int)std::max(1.0, DYNAMIC_CHUNK_WORK / std::max(cost, 1.0)));
+        return team;
+    }
+    int parts = team * config.grain;
+    omp_set_schedule(omp_sched_static, std::max(1, (n + parts - 1) / parts));
+    return team;
+}
+
+/**
+ * Tunes the kernels of every weight matrix for this host. The configurations of the
+ * matrices tuned by an earlier run are loaded from the tuning cache; the others are
+ * measured, and stored in the cache for later runs.
+ *
+ * @note    A configuration is measured by timing whole training steps on a constant input,
+ *          with only the configuration of the tuned matrix changing. The matrices are tuned
+ *          from the heaviest to the lightest, each one on top of the configurations already
+ *          picked. The candidates are every power of 2 (two) threads up to the model's threads,
+ *          with a dynamic schedule and with a static one of every grain in `TUNE_GRAINS`. A
+ *          single thread runs the matrix's loops inline, which is often the fastest for the
+ *          output layer.
+ *
+ * @note    The weights are restored afterwards, so the tuning leaves the model as initialized.
+ *          Only the fully connected layers are tuned.
+ */
+void nn::autotune(void)
+{
+    int matrices = layers.size() - 1;
+    std::vector<int> order(matrices);
+    std::vector<bool> tuned(matrices, false);
+    std::vector<int> candidates;
+    tuning_cache cache;
+    bool measured = false;
+
+    cache.load();
+    for (int m = 0; m < matrices; m += 1)
+    {
+        int rows = m == matrices - 1 ? layers[m + 1] : layers[m + 1] - 1;
+        tuned[m] = cache.find(threads, rows, layers[m], tuning[m]);
+        order[m] = m;
+    }
+    std::sort(order.begin(), order.end(), [&](int x, int y) { return (double)layers[x] * layers[x + 1] > (double)layers[y] * layers[y + 1]; });
+
+    std::vector<char> weights_before(parameter_bytes);
+    std::vector<double> x(layers[0] - 1, 0.5), y(layers[matrices], 0.0);
+    double* X = x.data(), * Y = y.data();
+    y[0] = 1.0;
+
+    auto measure = [&]()
+    {
+        double fastest = std::numeric_limits<double>::infinity();
+        forward();                                                                      /// Warms up the thread team and the caches
+        for (int repeat = 0; repeat < TUNE_REPEATS; repeat += 1)
+        {
+            double start = omp_get_wtime();
+            for (int step = 0; step < TUNE_STEPS; step += 1)
+            {
+                forward();
+                back_propagation_update(Y);
+            }
+            fastest = std::min(fastest, omp_get_wtime() - start);
+        }
+        return fastest / TUNE_STEPS;
+    };
+
+    for (int t = 1; t < threads; t *= 2)
+    {
+        candidates.push_back(t);
+    }
+    candidates.push_back(threads);
+
+    snapshot(weights_before.data());
+    bind_input(X);
+    for (int m : order)
+    {
+        if (tuned[m])
+        {
+            continue;
+        }
+        int rows = m == matrices - 1 ? layers[m + 1] : layers[m + 1] - 1;
+        double best = std::numeric_limits<double>::infinity();
+        kernel_config fastest(threads, 1);
+
+        for (int t : candidates)
+        {
+            std::vector<kernel_config> configs = { kernel_config(t, 1, STRATEGY_DYNAMIC) };
+            for (int grain : TUNE_GRAINS)
+            {
+                configs.push_back(kernel_config(t, grain, STRATEGY_STATIC));
+            }
+            if (t == 1)                                                                 /// The schedule of an inline loop makes no difference
+            {
+                configs.resize(1);
+            }
+            for (auto& config : configs)
+            {
+                tuning[m] = config;
+                double elapsed = measure();
+                if (elapsed < best)
+                {
+                    best = elapsed;
+                    fastest = tuning[m];
+                }
+            }
+        }
+        tuning[m] = fastest;
+        cache.store(threads, rows, layers[m], fastest);
+        measured = true;
+    }
+    restore(weights_before.data());
+
+    if (measured)
+    {
+        cache.save();
+    }
+    std::cout << "\n\nKernel Tuning:\t\t[" << cache.cpu << ", " << threads << " thread(s), " << (measured ? "measured" : "cached") << " in " << cache.filepath << "]\n";
+    for (int m = 0; m < matrices; m += 1)
+    {
+        std::cout << "\tLayer " << m + 1 << " -> " << m + 2 << ":\t";
+        if (tuning[m].threads == 1)
+        {
+            std::cout << "inline\n";
+        }
+        else if (tuning[m].strategy == STRATEGY_DYNAMIC)
+        {
+            std::cout << "up to " << tuning[m].threads << " thread(s), dynamic\n";
+        }
+        else
+        {
+            std::cout << "up to " << tuning[m].threads << " thread(s), static, " << tuning[m].grain << " chunk(s) per thread\n";
+        }
+    }
+}
@@ -39,7 +39,15 @@ int nn::get_label(double* (&y_pred))
  */
 int nn::predict(double* (&X))
 {
-    zero_grad(X);
+    if (features.empty())
+    {
+        bind_input(X);
+    }
+    else
+    {
+        extract(&X, 1);                                                 /// Feeds the input through the feature layers first
+        bind_input(flat[0]);
+    }
     forward();
     return get_label(a[layers.size() - 1]);
 }
@@ -58,58 +66,116 @@ void nn::set_layers(const std::vector<int>& l)
 }
 
 /**
- * Allocates memory space for the dynamic matrix that contains the neurons' unfiltered value.
+ * Allocates memory space for the dynamic matrix that contains the neurons' filtered value.
  *
  * @param[in, out] l the neural network layer structure vector
  *
- * @note    The `z` container for each neuron `i` in layer a `u` holds the sum given by the
+ * @note    The `a` container for each neuron `i` in layer `l` holds the sum given by the
  *          formula:
- *          \sum_j^L{synapse_{i, j} * value_{j}}, where synapse is the numerical weight
- *          of the synapse between neuron `i`, `j` and the value of `j` is the filtered
- *          output of that neuron and `L` is the number of neurons found in layer `u - 1`.
- *          The filter refers to the activation function used to 'activate' the neurons
- *          in the neural network.
+ *          f{(z_i)}, \forall i \in `l`, where f is the chosen activation function for every
+ *          neuron i the model and z_i is the weighted sum of the neuron's synapses.
+ *
+ * @note    There is no storage for the input layer. `a[0]` points to the input row bound
+ *          by `bind_input()`.
  */
-void nn::set_z(const std::vector<int>& l)
+void nn::set_a(const std::vector<int>& l)
 {
-    z = new double* [l.size()];
-    for (int i = 0; i < l.size(); i += 1)
+    a = memory.allocate<double*>(l.size());
+    a[0] = nullptr;
+    for (int i = 1; i < l.size(); i += 1)
     {
-        z[i] = new double[l[i]];
+        a[i] = memory.allocate<double>(l[i]);
     }
 }
 
 /**
- * Allocates memory space for the dynamic matrix that contains the neurons' filtered value.
+ * Allocates memory space for the dynamic matrix that contains the neurons' error, and for
+ * the partial sums of the threads that propagate it.
  *
  * @param[in, out] l the neural network layer structure vector
  *
- * @note    The `a` container for each neuron `i` in layer `l` holds the sum given by the
- *          formula:
- *          f{(z_i)}, \forall i \in `l`, where f is the chosen activation function for every
- *          neuron i the model.
+ * @note    Every thread that may run `propagate()` gets a row of partial sums as wide as the
+ *          widest input of a weight matrix. The rows are padded like the rows of the weights,
+ *          so no two threads ever write to the same cache line.
  */
-void nn::set_a(const std::vector<int>& l)
+void nn::set_delta(const std::vector<int>& l)
 {
-    a = new double* [l.size()];
-    for (int i = 0; i < l.size(); i += 1)
+    delta = memory.allocate<double*>(l.size() - 1);
+    for (int i = 1; i < l.size(); i += 1)
     {
-        a[i] = new double[l[i]];
+        delta[i - 1] = memory.allocate<double>(l[i]);
     }
+    partial = memory.allocate<double>((size_t)std::max(threads, host.threads) * widest(l));
 }
 
 /**
- * Allocates memory space for the dynamic matrix that contains the neurons' error.
+ * Computes the padded length of the widest input of a weight matrix, its bias excluded.
  *
- * @param[in, out] l the neural network layer structure vector
+ * @param[in] l the neural network layer structure vector
+ *
+ * @return the number of doubles of a row of partial sums
  */
-void nn::set_delta(const std::vector<int>& l)
+int nn::widest(const std::vector<int>& l)
+{
+    int columns = 0;
+
+    for (int i = 0; i < l.size() - 1; i += 1)
+    {
+        columns = std::max(columns, stride(l[i] - 1));
+    }
+    return columns;
+}
+
+/**
+ * Computes the number of doubles between two consecutive rows of a weight matrix.
+ * Rows are padded to a multiple of `ARENA_ALIGNMENT`, so that every row starts on
+ * a new cache line.
+ *
+ * @param[in] columns the number of synapses of a row
+ *
+ * @return the padded length of a row
+ */
+int nn::stride(int columns)
+{
+    return (int)(arena::align(columns * sizeof(double)) / sizeof(double));
+}
+
+/**
+ * Computes the size of the model's arena. The computation mirrors the order
+ * in which `set_weights`, `set_a`, `set_delta` and `set_feature_buffers` hand
+ * out sub-buffers.
+ *
+ * @param[in] l the neural network layer structure vector
+ *
+ * @return the number of bytes to reserve
+ */
+size_t nn::footprint(const std::vector<int>& l)
 {
-    delta = new double* [l.size() - 1];
+    size_t bytes = arena::align((l.size() - 1) * sizeof(double**));                   /// Weights container
+
+    if (!features.empty())
+    {
+        for (auto& layer : features)
+        {
+            bytes += arena::align(layer.parameters() * sizeof(double)) + layer.footprint();  /// Synapses and buffers of a feature layer
+        }
+        bytes += arena::align(CONV_BATCH * sizeof(double*)) + CONV_BATCH * arena::align((l[0] - 1) * sizeof(double));
+    }
+
     for (int i = 1; i < l.size(); i += 1)
     {
-        delta[i - 1] = new double[l[i]];
+        size_t rows = (i == l.size() - 1) ? l[i] : l[i] - 1;
+        bytes += arena::align(rows * stride(l[i - 1]) * sizeof(double));              /// Weight matrix of a layer
+        bytes += arena::align(rows * sizeof(double*));                                  /// Row pointers of a layer
     }
+    bytes += arena::align(l.size() * sizeof(double*));                                  /// `a` container
+    bytes += arena::align((l.size() - 1) * sizeof(double*));                            /// `delta` container
+    bytes += arena::align((size_t)std::max(threads, host.threads) * widest(l) * sizeof(double));   /// Partial sums of the threads
+    for (int i = 1; i < l.size(); i += 1)
+    {
+        bytes += 2 * arena::align(l[i] * sizeof(double));                               /// `a` and `delta` vectors
+    }
+    return bytes;
 }
 
 /**
@@ -118,82 +184,269 @@ void nn::set_delta(const std::vector<int>& l)
  * @param[in] l the neural network layer structure vector
  * @param[in] min the minimum weight of a synapse
  * @param[in] max the maximum weight of a synapse
+ *
+ * @note    The weight matrices of all layers are handed out first, so that they form a single
+ *          contiguous region at the start of the arena. That region (`parameter_bytes` long) is
+ *          the whole state of the model, which makes a snapshot a single `memcpy()`. The synapses
+ *          of the feature layers, if any, lead the region. They are initialized uniformly within
+ *          the He bound of the ReLU, and their biases start at zero. Since their outputs are not
+ *          bounded, the synapses of the first fully connected layer are then scaled down by the
+ *          square root of its fan-in.
+ *
+ * @note    The rows of every layer are first touched inside a parallel loop split like the default
+ *          plan of the kernels (see `plan()`): one static chunk of `ceil(rows / threads)` rows per
+ *          thread. That way, the partition of the weights consumed by a thread is placed on the
+ *          thread's NUMA node. The placement is best-effort: an invocation planned on fewer threads,
+ *          such as a small layer's, or a tuned grain or dynamic schedule, reads some rows from other
+ *          nodes. The random initialization is done afterwards by the master thread, which does not
+ *          move the pages that have already been touched.
  */
 void nn::set_weights(const std::vector<int>& l, const double min, const double max)
 {
     std::random_device rd;                                              /// Initializes non-deterministic random generator
     std::mt19937 gen(rd());                                             /// Seeds mersenne twister
     std::uniform_real_distribution<> dist(min, max);                    /// Distribute results between `min` and `max` inclusive
+    std::vector<double*> matrices(l.size() - 1);
+    double scale = features.empty() ? 1.0 : 1.0 / std::sqrt((double)l[0]);  /// Keeps the sigmoids of the first layer out of saturation, over the unbounded features
 
-    weights = new double** [l.size() - 1];                              /// Allocates memory for the weights container
-    for (int i = 1; i < l.size() - 1; i += 1)
+    for (auto& layer : features)
     {
-        weights[i - 1] = new double* [l[i] - 1];                        /// Allocates memory for the weights of a layer in a neural network
-        for (int j = 0; j < l[i] - 1; j += 1)
+        if (layer.kind == LAYER_CONV2D)
         {
-            weights[i - 1][j] = new double[l[i - 1]];                   /// Allocates memory for the weights of each neuron in a layer
-            for (int k = 0; k < l[i - 1]; k += 1)
+            double bound = std::sqrt(6.0 / layer.reduction());
+            std::uniform_real_distribution<> he(-bound, bound);
+            layer.weights = memory.allocate<double>(layer.parameters());
+            for (int f = 0; f < layer.out_c; f += 1)
             {
-                weights[i - 1][j][k] = dist(gen);                       /// Uses random generator to initialize synapse
+                double* w = layer.weights + (size_t)f * (layer.reduction() + 1);
+                for (int r = 0; r < layer.reduction(); r += 1)
+                {
+                    w[r] = he(gen);
+                }
+                w[layer.reduction()] = 0.0;
             }
         }
     }
-    weights[l.size() - 2] = new double* [l[l.size() - 1]];              /// Initializes weights in the output layer
-    for (int j = 0; j < l[l.size() - 1]; j += 1)                        /// There is no bias in the output layer
+    for (int i = 1; i < l.size(); i += 1)                               /// Hands out the contiguous parameter region
+    {
+        int rows = (i == l.size() - 1) ? l[i] : l[i] - 1;               /// There is no bias in the output layer
+        matrices[i - 1] = memory.allocate<double>((size_t)rows * stride(l[i - 1]));
+    }
+    parameter_bytes = memory.used;
+
+    weights = memory.allocate<double**>(l.size() - 1);                  /// Allocates memory for the weights container
+    for (int i = 1; i < l.size(); i += 1)
     {
-        weights[l.size() - 2][j] = new double[l[l.size() - 2]];         /// Allocates memory for the weights of each neuron in the output layer
-        for (int k = 0; k < l[l.size() - 2]; k += 1)
+        int rows = (i == l.size() - 1) ? l[i] : l[i] - 1;
+        int ld = stride(l[i - 1]);
+        int chunk = (rows + threads - 1) / threads;                     /// Splits the rows like `plan()` does for the whole team
+        weights[i - 1] = memory.allocate<double*>(rows);                /// Allocates memory for the row pointers of a layer in a neural network
+#pragma omp parallel for num_threads(threads) schedule(static, chunk)
+        for (int j = 0; j < rows; j += 1)
         {
-            weights[l.size() - 2][j][k] = dist(gen);                    /// Uses random generator to initialize synapse
+            weights[i - 1][j] = matrices[i - 1] + (size_t)j * ld;       /// Points to the weights of each neuron in a layer
+            std::fill_n(weights[i - 1][j], ld, 0.0);                    /// First touches the row on the node of the thread that consumes it
+        }
+        for (int j = 0; j < rows; j += 1)
+        {
+            for (int k = 0; k < l[i - 1]; k += 1)
+            {
+                weights[i - 1][j][k] = dist(gen) * (i == 1 ? scale : 1.0);  /// Uses random generator to initialize synapse
+            }
         }
     }
 }
 
+/**
+ * Initializes the model. All the model's buffers are handed out by the model's
+ * arena, which is sized here with a single allocation.
+ *
+ * @param[in] l the neural network layer structure vector
+ * @param[in] min the minimum weight of a synapse
+ * @param[in] max the maximum weight of a synapse
+ *
+ * @note    Unless the model has been given its own number of threads, it uses all the threads of the host.
+ *
+ * @note    If the model has feature layers, its input has to be an image of the dataset, and the input
+ *          layer of the fully connected layers is resized to the output of the last feature layer. Such
+ *          a model is never trained through a pipeline.
+ *
+ * @note    Layers are frozen by their flag in `frozen`, one per weight matrix, given before the call.
+ *          A model with frozen layers, or a selective sampler, is never trained through a pipeline either:
+ *          requesting stages for any of these models throws `std::invalid_argument`.
+ *
+ * @note    Every weight matrix starts with the default configuration of its kernels (all the model's
+ *          threads, a static chunk per thread). If tuning is enabled, the configurations are then tuned.
+ */
 void nn::compile(const std::vector<int>& l, const double min, const double max)
 {
-    set_layers(l);
-    set_z(l);
-    set_a(l);
-    set_delta(l);
-    set_weights(l, min, max);
+    std::vector<int> structure = l;
+
+    threads = threads > 0 ? threads : host.threads;
+    if (!features.empty())
+    {
+        if (l[0] - 1 != MNIST_CHANNELS * MNIST_HEIGHT * MNIST_WIDTH)
+        {
+            throw std::runtime_error("compile: the feature layers expect an input of " + std::to_string(MNIST_CHANNELS * MNIST_HEIGHT * MNIST_WIDTH) + " values");
+        }
+        structure[0] = set_features() + 1;
+    }
+    if (frozen.size() > structure.size() - 1)
+    {
+        throw std::runtime_error("compile: only layers 1 to " + std::to_string(structure.size() - 1) + " can be frozen");
+    }
+    frozen.resize(structure.size() - 1, false);
+    if (std::find(frozen.begin(), frozen.end(), false) == frozen.end())
+    {
+        throw std::runtime_error("compile: every layer is frozen, there is nothing to train");
+    }
+    if (stages > 1 && (!features.empty() || std::find(frozen.begin(), frozen.end(), true) != frozen.end() || selective.active()))
+    {
+        throw std::invalid_argument("compile: feature layers, frozen layers and the selective sampler cannot be trained through a pipeline");
+    }
+    set_layers(structure);
+    tuning.assign(structure.size() - 1, kernel_config(threads, 1));
+    memory.reserve(footprint(structure), ARENA_HUGETLB);
+    set_weights(structure, min, max);
+    set_a(structure);
+    set_delta(structure);
+    if (!features.empty())
+    {
+        set_feature_buffers();
+    }
+    if (tune)
+    {
+        autotune();
+    }
+}
+
+/**
+ * Copies the whole state of the model (the weights of all layers) into a buffer.
+ *
+ * @param[in, out] buffer a buffer of at least `parameter_bytes` bytes
+ */
+void nn::snapshot(void* buffer)
+{
+    std::memcpy(buffer, memory.base, parameter_bytes);
+}
+
+/**
+ * Restores the whole state of the model from a snapshot.
+ *
+ * @param[in] buffer a snapshot of a model with the same layer structure
+ */
+void nn::restore(const void* buffer)
+{
+    std::memcpy(memory.base, buffer, parameter_bytes);
+}
+
+/**
+ * Resumes the model from a checkpoint written during an earlier training.
+ *
+ * @param[in] filename the filepath of the checkpoint
+ *
+ * @note The checkpoint has to be taken from a model with the same layer structure.
+ */
+void nn::resume(const char* filename)
+{
+    long step;
+
+    read_checkpoint(filename, layers, memory.base, parameter_bytes, step);
+    std::cout << "\n\nResumed from " << filename << " (step " << step << ")\n";
+}
+
+/**
+ * Compiles the model from a checkpoint, and reads the checkpoint's weights into it.
+ *
+ * @param[in] filename the filepath of the checkpoint
+ *
+ * @return the training step the checkpoint was taken at
+ *
+ * @note The feature layers are not part of a checkpoint, so the model is fully connected.
+ */
+long nn::load(const char* filename)
+{
+    long step;
+
+    compile(checkpoint_layers(filename), 0.0, 0.0);
+    read_checkpoint(filename, layers, memory.base, parameter_bytes, step);
+    return step;
+}
+
+/**
+ * Binds an input vector to the input layer of the model. The vector is not copied.
+ *
+ * @param[in, out] X a vector that has been initialized with a sample from a data subset
+ *
+ * @note    There is nothing to clear between samples, since `forward()` and `back_propagation()`
+ *          overwrite every value and every error of the model before reading it.
+ *
+ * @note Although passed by reference, the `X` placeholder is not altered.
+ */
+void nn::bind_input(double* (&X))
+{
+    a[0] = X;
+    input_nnz = -1;
 }
 
 /**
- * Clears the past values computed created during feed forward and/or back propagation processes.
+ * Binds a sample of a dataset to the input layer of the model. If the sparse kernels
+ * have been selected, the sample's sparse encoding is bound along with the dense one.
  *
- * @param[in, out] X a vector that has been initialized with a random sample from the training data subset
+ * @param[in, out] data the dataset that holds the sample
+ * @param[in] sample the index of the sample in the dataset
  *
- * @note This function is called upon both training and evaluation. That's why it also clears past values of the `delta` container.
+ * @note Although passed by reference, `data` is not altered.
  */
-void nn::zero_grad(double* (&X))
+void nn::bind_input(dataset(&data), int sample)
 {
-    for (int j = 0; j < layers[0] - 1; j += 1)                          /// Prepare - initialize input layer
+    a[0] = data.X[sample];
+    input_nnz = -1;
+    if (sparse_input)
     {
-        z[0][j] = X[j];
-        a[0][j] = X[j];
+        input_nnz = data.offsets[sample + 1] - data.offsets[sample];
+        input_index = data.indices + data.offsets[sample];
+        input_value = data.values + data.offsets[sample];
     }
-    z[0][layers[0] - 1] = 1.0;
-    a[0][layers[0] - 1] = 1.0;
+}
+
+/**
+ * Selects between the dense and the sparse kernels of the first layer for a dataset.
+ * If the dataset's inputs are dense, the dense kernels are selected right away. Otherwise,
+ * the dataset is encoded as sparse, and both kernels feed forward the same samples. The
+ * fastest of the two is selected.
+ *
+ * @param[in, out] data the dataset to be fed to the model
+ *
+ * @note    Only the model's activations are altered by the measurement. The selection
+ *          holds until the next call, and `bind_input()` uses it to bind the samples.
+ *
+ * @note    The output of the feature layers is always bound dense.
+ */
+void nn::select_input_kernel(dataset(&data))
+{
+    int probes = std::min(data.samples, 256);
+    double elapsed[2];
 
-    for (int i = 1; i < layers.size() - 1; i += 1)                      /// Prepare - initialize hidden layers
+    sparse_input = false;
+    if (data.density >= SPARSE_DENSITY || probes == 0 || !features.empty())
     {
-        for (int j = 0; j < layers[i] - 1; j += 1)
-        {
-            z[i][j] = 0.0;
-            a[i][j] = 0.0;
-            delta[i - 1][j] = 0.0;
-        }
-        z[i][layers[i] - 1] = 1.0;
-        a[i][layers[i] - 1] = 1.0;
-        delta[i - 1][layers[i] - 1] = 0.0;
+        return;
     }
+    data.encode_sparse();
 
-    for (int j = 0; j < layers[layers.size() - 1]; j += 1)              /// Prepare - initialize output layer
+    for (int mode = 0; mode < 2; mode += 1)                                     /// Benchmarks the dense (0) and the sparse (1) kernels
     {
-        z[layers.size() - 1][j] = 0.0;
-        a[layers.size() - 1][j] = 0.0;
-        delta[layers.size() - 2][j] = 0.0;
+        sparse_input = mode == 1;
+        elapsed[mode] = omp_get_wtime();
+        for (int sample = 0; sample < probes; sample += 1)
+        {
+            bind_input(data, sample);
+            forward();
+        }
+        elapsed[mode] = omp_get_wtime() - elapsed[mode];
     }
+    sparse_input = elapsed[1] < elapsed[0];
 }
 
 /**
@@ -207,8 +460,73 @@ void nn::summary(void)
 
     std::cout << "\n\nNeural Network Summary:\t\t[f := Sigmoid]\n" << s << std::endl;
     
+    for (auto& layer : features)
+    {
+        std::cout << (layer.kind == LAYER_CONV2D ? "Conv2D " : "MaxPool") << "\t" << layer.size << "x" << layer.size << " -> "
+                  << layer.out_c << "x" << layer.out_h << "x" << layer.out_w << (layer.kind == LAYER_CONV2D ? "\t[f := ReLU]\n" : "\n");
+    }
     for (auto& elem : layers)
     {
-        std::cout << "Layer [" << ++l << "]\t" << std::setw(4) << elem << " neurons\n";
+        std::cout << "Layer [" << ++l << "]\t" << std::setw(4) << elem << " neurons" << (l > 1 && frozen[l - 2] ? "\t(frozen)\n" : "\n");
     }
+    std::cout << "Arena\t" << std::setw(8) << memory.capacity / 1024 << " KiB (" << parameter_bytes / 1024 << " KiB of weights)"
+              << (memory.huge ? " on huge pages\n" : "\n");
+}
+
+/**
+ * Prints the placement of the model and the training data across the host's NUMA nodes.
+ * For every thread, it measures the bytes of its weight partition, and of a sample of the
+ * input rows, that reside on a remote node, and then estimates the memory traffic of a
+ * training step that crosses nodes.
+ *
+ * @param[in, out] TRAIN the training dataset
+ *
+ * @note    During a training step, every weight is read by `forward()` and then read and written
+ *          by `back_propagation_update()`, while the whole input row is read by every thread. The
+ *          input rows are interleaved across the nodes for bandwidth, so the threads outside the node
+ *          of a sample always read it remotely. The expected output is small, and is not counted. The rows of
+ *          a thread are those of the default plan of the kernels, one static chunk per thread over
+ *          the model's threads. Kernels planned on fewer threads, or tuned to another schedule,
+ *          split the rows differently, so the estimation only approximates their traffic.
+ *          The estimation does not account for the activation and error vectors, which are small
+ *          enough to live in the threads' caches.
+ *
+ * @note Although passed by reference, `TRAIN` is not altered.
+ */
+void nn::numa_summary(dataset(&TRAIN))
+{
+    int probes = 0, stride = TRAIN.samples / 64 + 1;
+    double local = 0.0, remote = 0.0, row_remote = 0.0;
+    std::string s(CLI_WINDOW_WIDTH + 10, '-');
+
+    for (int thread = 0; thread < threads; thread += 1)
+    {
+        int node = host.thread_node(thread);
+        for (int i = 1; i < layers.size(); i += 1)
+        {
+            int rows = (i == layers.size() - 1) ? layers[i] : layers[i] - 1;
+            int chunk = (rows + threads - 1) / threads;                                         /// Mirrors the default plan of the kernels, and the first touch
+            int begin = std::min(rows, thread * chunk);
+            int end = std::min(rows, begin + chunk);
+            for (int j = begin; j < end; j += 1)
+            {
+                double bytes = layers[i - 1] * sizeof(double);
+                double far = host.remote_bytes(weights[i - 1][j], bytes, node);
+                remote += 3.0 * far;                                                            /// Counts 1 read, then 1 read and 1 write per step
+                local += 3.0 * (bytes - far);
+            }
+        }
+        for (int sample = 0; sample < TRAIN.samples; sample += stride)                          /// Samples the placement of the training data
+        {
+            probes += 1;
+            row_remote += host.remote_bytes(TRAIN.X[sample], TRAIN.dimensions * sizeof(double), node);
+        }
+    }
+    row_remote = row_remote * threads / std::max(probes, 1);                                    /// Averages remote input bytes of a sample over all threads
+    remote += row_remote;
+    local += threads * TRAIN.dimensions * sizeof(double) - row_remote;
+
+    std::cout << "\n\nNUMA Placement:\t\t[" << host.threads << " threads, " << host.nodes << " node(s), " << host.policy_name() << " affinity]\n" << s << std::endl;
+    std::cout << "Memory traffic per training step: " << std::fixed << std::setprecision(2) << (local + remote) / 1024.0 << " KiB\n";
+    std::cout << "Traffic crossing NUMA nodes:      " << std::fixed << std::setprecision(2) << remote / 1024.0 << " KiB (" << 100.0 * remote / (local + remote) << " %)\n";
 }